@@ -0,0 +1,241 @@
+#!/usr/bin/perl
+# Benchmarks bfc on the programs of a directory.
+
+# Copyright (C) 2019 Sergey Sushilin
+# This file is part of the BrainFuck Compiler
+
+# BrainFuck Compiler is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License as
+# published by the Free Software Foundation, either version 3 of
+# the License, or (at your option) any later version.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Every NAME.bf of the directory is compiled at every optimization
+# level, and the compile time, the size of the executable and its run
+# time are measured over several trials.  The program reads NAME.in if
+# it exists, or the output of the Perl script NAME.in.pl.  The outputs
+# of all levels must be the same.
+
+use strict;
+use warnings;
+
+use Digest::MD5;
+use File::Basename;
+use File::Temp qw(tempdir);
+use Getopt::Long;
+use POSIX qw(_exit);
+use Time::HiRes qw(time);
+
+my $bfc = 'src/bfc';
+my $levels = '0,1,2';
+my $trials = 5;
+my $json;
+
+sub usage ($)
+{
+  my ($status) = @_;
+  print STDERR <<EOT;
+Usage: $0 [OPTION]... [DIRECTORY]
+Benchmark bfc on the programs of DIRECTORY, by default the directory
+of this script.
+
+  --bfc=FILE       Use the compiler FILE, by default $bfc.
+  --levels=LIST    Compile at the comma separated optimization levels
+                   of LIST, by default $levels.
+  --trials=N       Compile and run every program N times, by default $trials.
+  --json=FILE      Write the results to FILE as JSON, - for stdout.
+  --help           Display this help and exit.
+EOT
+  exit $status;
+}
+
+GetOptions ('bfc=s' => \$bfc,
+            'levels=s' => \$levels,
+            'trials=i' => \$trials,
+            'json=s' => \$json,
+            'help' => sub { usage 0 })
+  or usage 1;
+@ARGV <= 1 && $trials >= 1
+  or usage 1;
+
+my $dir = @ARGV ? $ARGV[0] : dirname ($0);
+my @levels = split /,/, $levels;
+my $tmp = tempdir ('bfc-bench-XXXXXX', TMPDIR => 1, CLEANUP => 1);
+
+# Runs COMMAND with its input from IN and its output to OUT, returns
+# its wall time in seconds and its exit status.
+sub run_timed ($$$)
+{
+  my ($command, $in, $out) = @_;
+  my $start = time;
+  my $pid = fork;
+  defined $pid
+    or die "$0: fork: $!\n";
+  if ($pid == 0)
+    {
+      open STDIN, '<', $in or _exit 126;
+      open STDOUT, '>', $out or _exit 126;
+      exec @$command or _exit 127;
+    }
+  waitpid $pid, 0;
+  my $status = $?;
+  return (time - $start, $status);
+}
+
+# Median, mean and sample variance of the list.
+sub statistics (@)
+{
+  my @sorted = sort { $a <=> $b } @_;
+  my $n = @sorted;
+  my $median = $n % 2 ? $sorted[$n / 2]
+                      : ($sorted[$n / 2 - 1] + $sorted[$n / 2]) / 2;
+  my $mean = 0;
+  $mean += $_ / $n for @sorted;
+  my $variance = 0;
+  if ($n > 1)
+    {
+      $variance += ($_ - $mean) ** 2 / ($n - 1) for @sorted;
+    }
+  return { median => $median, mean => $mean, variance => $variance,
+           min => $sorted[0], max => $sorted[-1] };
+}
+
+sub digest ($)
+{
+  my ($file) = @_;
+  open my $fh, '<', $file or die "$0: $file: $!\n";
+  binmode $fh;
+  return Digest::MD5->new->addfile ($fh)->hexdigest;
+}
+
+my @results;
+my $failed = 0;
+
+printf "%-12s %3s %12s %12s %10s %12s %12s\n",
+  'program', '-O', 'compile (s)', 'variance', 'size (B)', 'run (s)', 'variance';
+
+for my $source (sort glob "$dir/*.bf")
+  {
+    my $name = basename ($source, '.bf');
+    my $in = '/dev/null';
+    if (-e "$dir/$name.in")
+      {
+        $in = "$dir/$name.in";
+      }
+    elsif (-e "$dir/$name.in.pl")
+      {
+        $in = "$tmp/$name.in";
+        system ("$^X '$dir/$name.in.pl' > '$in'") == 0
+          or die "$0: $dir/$name.in.pl failed\n";
+      }
+
+    my $expected;
+    for my $level (@levels)
+      {
+        my $exe = "$tmp/$name-O$level";
+        my $out = "$tmp/$name.out";
+        my %result = (program => $name, level => $level + 0);
+        my (@compile, @run);
+
+        for (1 .. $trials)
+          {
+            unlink $exe;
+            my ($seconds, $status)
+              = run_timed ([$bfc, "-O$level", '-o', $exe, $source],
+                           '/dev/null', '/dev/null');
+            if ($status != 0)
+              {
+                $result{error} = "compilation failed with status $status";
+                last;
+              }
+            push @compile, $seconds;
+          }
+
+        if (!exists $result{error})
+          {
+            $result{size} = -s $exe;
+            for (1 .. $trials)
+              {
+                my ($seconds, $status) = run_timed ([$exe], $in, $out);
+                if ($status != 0)
+                  {
+                    $result{error} = "run failed with status $status";
+                    last;
+                  }
+                push @run, $seconds;
+              }
+          }
+
+        if (!exists $result{error})
+          {
+            $result{output} = 'md5:' . digest ($out);
+            $expected = $result{output}
+              unless defined $expected;
+            $result{error} = 'output differs from the first level'
+              if $result{output} ne $expected;
+          }
+
+        $result{compile} = statistics (@compile) if @compile;
+        $result{run} = statistics (@run) if @run == $trials;
+
+        if (exists $result{error})
+          {
+            $failed++;
+            printf "%-12s %3s %s\n", $name, $level, $result{error};
+          }
+        else
+          {
+            printf "%-12s %3s %12.6f %12.3g %10d %12.6f %12.3g\n",
+              $name, $level,
+              $result{compile}{median}, $result{compile}{variance},
+              $result{size},
+              $result{run}{median}, $result{run}{variance};
+          }
+
+        push @results, \%result;
+      }
+  }
+
+sub to_json ($);
+sub to_json ($)
+{
+  my ($value) = @_;
+  if (ref $value eq 'HASH')
+    {
+      return '{' . join (', ', map { to_json ($_) . ': ' . to_json ($value->{$_}) }
+                                   sort keys %$value) . '}';
+    }
+  if (ref $value eq 'ARRAY')
+    {
+      return "[\n  " . join (",\n  ", map { to_json ($_) } @$value) . "\n]";
+    }
+  return $value
+    if $value =~ /^-?(?:0|[1-9][0-9]*)(?:\.[0-9]+)?(?:[eE][-+]?[0-9]+)?$/;
+  $value =~ s/(["\\])/\\$1/g;
+  return "\"$value\"";
+}
+
+if (defined $json)
+  {
+    my $fh;
+    if ($json eq '-')
+      {
+        $fh = \*STDOUT;
+      }
+    else
+      {
+        open $fh, '>', $json or die "$0: $json: $!\n";
+      }
+    print $fh to_json ({ bfc => $bfc, trials => $trials,
+                         results => \@results }), "\n";
+    close $fh or die "$0: $json: $!\n";
+  }
+
+exit ($failed ? 1 : 0);
@@ -0,0 +1,3 @@
+Bulk input and output filter: adds 13 to every byte
+
+,[+++++++++++++.[-],]
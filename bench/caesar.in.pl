@@ -0,0 +1,5 @@
+# Input of caesar.bf: 1 MiB of text.  Every byte read flushes the
+# output, so this is mostly a benchmark of the system calls.
+my $line = "The quick brown fox jumps over the lazy dog 0123456789\n";
+my $size = 1024 * 1024;
+print substr ($line x ($size / length ($line) + 1), 0, $size);
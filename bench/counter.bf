@@ -0,0 +1,29 @@
+Long arithmetic: prints every number from 000000 to 999999
+on its own line with a six digit decimal counter
+
+>>>>++++++++++>>>>++++++++++>>>>++++++++++>>>>++++++++++>>>>++++++++++>>
+>>++++++++++<<<<<<<<<<<<<<<<<<<<<<<<++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[>++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++[>++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++[>>>>>>>>>>>>>>>>>>>
+>>>[>+>+<<-]>>[<<+>>-]>>++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++<<<[>>>-<<<-]>>>.[-]<<<<<<<<[>+>+<<-]>>[<<+>>-]>>>>>>+++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++<<<<<<<[>>>>>>>-<<<<<<<
+-]>>>>>>>.[-]<<<<<<<<<<<<[>+>+<<-]>>[<<+>>-]>>>>>>>>>>++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++<<<<<<<<<<<[>>>>>>>>>>>-<<<<<<<<
+<<<-]>>>>>>>>>>>.[-]<<<<<<<<<<<<<<<<[>+>+<<-]>>[<<+>>-]>>>>>>>>>>>>>>+++
++++++++++++++++++++++++++++++++++++++++++++++++++++++++<<<<<<<<<<<<<<<[>
+>>>>>>>>>>>>>>-<<<<<<<<<<<<<<<-]>>>>>>>>>>>>>>>.[-]<<<<<<<<<<<<<<<<<<<<[
+>+>+<<-]>>[<<+>>-]>>>>>>>>>>>>>>>>>>++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++<<<<<<<<<<<<<<<<<<<[>>>>>>>>>>>>>>>>>>>-<<<<<<<<<<
+<<<<<<<<<-]>>>>>>>>>>>>>>>>>>>.[-]<<<<<<<<<<<<<<<<<<<<<<<<[>+>+<<-]>>[<<
++>>-]>>>>>>>>>>>>>>>>>>>>>>+++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++<<<<<<<<<<<<<<<<<<<<<<<[>>>>>>>>>>>>>>>>>>>>>>>-<<<<<<<<<<<
+<<<<<<<<<<<<-]>>>>>>>>>>>>>>>>>>>>>>>.[-]++++++++++.[-]<<<<<<<<<<<<<<<<<
+<<<<<<<-[>+>+<<-]>>[<<+>>-]>+<<[>>-<<[-]]>>[-<<<++++++++++>>>>-[>+>+<<-]
+>>[<<+>>-]>+<<[>>-<<[-]]>>[-<<<++++++++++>>>>-[>+>+<<-]>>[<<+>>-]>+<<[>>
+-<<[-]]>>[-<<<++++++++++>>>>-[>+>+<<-]>>[<<+>>-]>+<<[>>-<<[-]]>>[-<<<+++
++++++++>>>>-[>+>+<<-]>>[<<+>>-]>+<<[>>-<<[-]]>>[-<<<++++++++++>>>>-[>+>+
+<<-]>>[<<+>>-]>+<<[>>-<<[-]]>>[-<<<++++++++++>>>]<<<<]<<<<]<<<<]<<<<]<<<
+<]<<<<<-]<-]<-]
@@ -0,0 +1,34 @@
+# Benchmarks of bfc.                             -*-Makefile-*-
+# This is included by the top-level Makefile.am.
+
+## Copyright (C) 2019 Sergey Sushilin
+
+## This program is free software: you can redistribute it and/or modify
+## it under the terms of the GNU General Public License as published by
+## the Free Software Foundation, either version 3 of the License, or
+## (at your option) any later version.
+##
+## This program is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+EXTRA_DIST +=                           \
+  bench/bench.pl                        \
+  bench/caesar.bf                       \
+  bench/caesar.in.pl                    \
+  bench/counter.bf                      \
+  bench/loops.bf                        \
+  bench/wc.bf                           \
+  bench/wc.in.pl
+
+# Options of bench/bench.pl, e.g. 'make bench BENCH_FLAGS=--json=bench.json'.
+BENCH_FLAGS =
+
+bench: src/bfc$(EXEEXT)
+	$(PERL) $(srcdir)/bench/bench.pl --bfc=src/bfc$(EXEEXT) \
+	  $(BENCH_FLAGS) $(srcdir)/bench
+.PHONY: bench
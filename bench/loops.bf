@@ -0,0 +1,3 @@
+Nested loops which the optimizer cannot turn into straight line code
+
+++++++++[>-[>-[>-[>+>[-]+<<-]<-]<-]<-]>>>>.
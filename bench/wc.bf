@@ -0,0 +1,34 @@
+Bulk input: counts the bytes of its input with an eight digit
+decimal counter and prints the count
+
+>>>>++++++++++>>>>++++++++++>>>>++++++++++>>>>++++++++++>>>>++++++++++>>
+>>++++++++++>>>>++++++++++>>>>++++++++++<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+,[>>>>-[>+>+<<-]>>[<<+>>-]>+<<[>>-<<[-]]>>[-<<<++++++++++>>>>-[>+>+<<-]>
+>[<<+>>-]>+<<[>>-<<[-]]>>[-<<<++++++++++>>>>-[>+>+<<-]>>[<<+>>-]>+<<[>>-
+<<[-]]>>[-<<<++++++++++>>>>-[>+>+<<-]>>[<<+>>-]>+<<[>>-<<[-]]>>[-<<<++++
+++++++>>>>-[>+>+<<-]>>[<<+>>-]>+<<[>>-<<[-]]>>[-<<<++++++++++>>>>-[>+>+<
+<-]>>[<<+>>-]>+<<[>>-<<[-]]>>[-<<<++++++++++>>>>-[>+>+<<-]>>[<<+>>-]>+<<
+[>>-<<[-]]>>[-<<<++++++++++>>>>-[>+>+<<-]>>[<<+>>-]>+<<[>>-<<[-]]>>[-<<<
+++++++++++>>>]<<<<]<<<<]<<<<]<<<<]<<<<]<<<<]<<<<]<<<<<<<[-],]>>>>>>>>>>>
+>>>>>>>>>>>>>>>>>>>>>[>+>+<<-]>>[<<+>>-]>>++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++<<<[>>>-<<<-]>>>.[-]<<<<<<<<[>+>+<<-]>>[<<+>
+>-]>>>>>>++++++++++++++++++++++++++++++++++++++++++++++++++++++++++<<<<<
+<<[>>>>>>>-<<<<<<<-]>>>>>>>.[-]<<<<<<<<<<<<[>+>+<<-]>>[<<+>>-]>>>>>>>>>>
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++<<<<<<<<<<<[>>
+>>>>>>>>>-<<<<<<<<<<<-]>>>>>>>>>>>.[-]<<<<<<<<<<<<<<<<[>+>+<<-]>>[<<+>>-
+]>>>>>>>>>>>>>>+++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++<<<<<<<<<<<<<<<[>>>>>>>>>>>>>>>-<<<<<<<<<<<<<<<-]>>>>>>>>>>>>>>>.[-]<<<
+<<<<<<<<<<<<<<<<<[>+>+<<-]>>[<<+>>-]>>>>>>>>>>>>>>>>>>++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++<<<<<<<<<<<<<<<<<<<[>>>>>>>>>>>>
+>>>>>>>-<<<<<<<<<<<<<<<<<<<-]>>>>>>>>>>>>>>>>>>>.[-]<<<<<<<<<<<<<<<<<<<<
+<<<<[>+>+<<-]>>[<<+>>-]>>>>>>>>>>>>>>>>>>>>>>+++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++<<<<<<<<<<<<<<<<<<<<<<<[>>>>>>>>>>>>>>>>>
+>>>>>>-<<<<<<<<<<<<<<<<<<<<<<<-]>>>>>>>>>>>>>>>>>>>>>>>.[-]<<<<<<<<<<<<<
+<<<<<<<<<<<<<<<[>+>+<<-]>>[<<+>>-]>>>>>>>>>>>>>>>>>>>>>>>>>>++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++<<<<<<<<<<<<<<<<<<<<<<<<<<
+<[>>>>>>>>>>>>>>>>>>>>>>>>>>>-<<<<<<<<<<<<<<<<<<<<<<<<<<<-]>>>>>>>>>>>>>
+>>>>>>>>>>>>>>.[-]<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<[>+>+<<-]>>[<<+>>-]>>>
+>>>>>>>>>>>>>>>>>>>>>>>>>>>+++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<[>>>>>>>>>>>>>>>>>>>>>>>>>>>
+>>>>-<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<-]>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>.[-
+]++++++++++.[-]
@@ -0,0 +1,4 @@
+# Input of wc.bf: 4 MiB of text.
+my $line = "The quick brown fox jumps over the lazy dog 0123456789\n";
+my $size = 4 * 1024 * 1024;
+print substr ($line x ($size / length ($line) + 1), 0, $size);
@@ -21,7 +21,10 @@
 
 #include <assert.h>
 #include <error.h>
+#include <signal.h>
+#include <spawn.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,27 +35,79 @@
 
 #include "compiler.h"
 #include "die.h"
+#include "profile.h"
+#include "xalloc.h"
 
+/* Runs ARG and waits for it.  If SOURCE is not NULL, its assembly
+   source code is written to the standard input of ARG through a pipe
+   while ARG runs.  Returns the exit status of ARG, 128 plus the signal
+   number if it was killed, or 127 if it could not be started.  */
 static int
-exec (char **arg)
+exec (char **arg, const ProgramSource *source)
 {
   int status = -1;
-  pid_t pid  = fork ();
+  int fds[2];
 
-  if (pid < 0)
-    /* Fork error.  */
-    die (EXIT_FAILURE, errno, "%s", arg[0]);
-  else if (pid == 0)
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init (&actions);
+  if (source != NULL)
     {
-      /* Child process.  */
-      execvp (arg[0], arg);
-      die (EXIT_FAILURE, errno, "%s", arg[0]);
+      if (pipe (fds) != 0)
+        die (EXIT_FAILURE, errno, "pipe()");
+      posix_spawn_file_actions_adddup2 (&actions, fds[0], STDIN_FILENO);
+      posix_spawn_file_actions_addclose (&actions, fds[0]);
+      posix_spawn_file_actions_addclose (&actions, fds[1]);
     }
-  else /* pid > 0 */
-    /* Parent process.  */
-    wait (&status);
 
-  return status;
+  /* posix_spawnp does not copy the address space of the compiler
+     like fork does.  */
+  pid_t pid;
+  int err = posix_spawnp (&pid, arg[0], &actions, NULL, arg, environ);
+  posix_spawn_file_actions_destroy (&actions);
+
+  if (source != NULL)
+    close (fds[0]);
+
+  if (err != 0)
+    {
+      if (source != NULL)
+        close (fds[1]);
+      error (0, err, "%s", arg[0]);
+      return 127;
+    }
+
+  if (source != NULL)
+    {
+      FILE *stream = fdopen (fds[1], "w");
+      if (stream == NULL)
+        die (EXIT_FAILURE, errno, "fdopen()");
+
+      /* If the child dies early, writes fail with EPIPE and its exit
+         status tells what went wrong.  */
+      struct sigaction ignore, saved;
+      memset (&ignore, 0, sizeof (ignore));
+      ignore.sa_handler = SIG_IGN;
+      sigaction (SIGPIPE, &ignore, &saved);
+
+      setvbuf (stream, NULL, _IOFBF, ASM_BUFFER_SIZE);
+      tokens_to_asm (source, stream);
+      fclose (stream);
+
+      sigaction (SIGPIPE, &saved, NULL);
+    }
+
+  while (waitpid (pid, &status, 0) < 0)
+    if (errno != EINTR)
+      die (EXIT_FAILURE, errno, "waitpid()");
+
+  if (WIFSIGNALED (status))
+    {
+      error (0, 0, _("%s terminated by signal %s"),
+             arg[0], strsignal (WTERMSIG (status)));
+      return 128 + WTERMSIG (status);
+    }
+
+  return WEXITSTATUS (status);
 }
 
 #if defined(__x86_64__)
@@ -63,67 +118,158 @@ exec (char **arg)
 # error Unknown arch
 #endif
 
-void
-tokens_to_asm (ProgramSource *const source,
-               char **final_output,
-               size_t *final_output_length)
+/* Write LENGTH bytes of BYTES to STREAM as data directives.  */
+static void
+write_bytes (FILE *stream, const char *bytes, size_t length)
 {
-  *final_output = NULL;
-  *final_output_length = 0;
-  char *output = NULL;
-  size_t output_length = 0;
+  for (size_t i = 0; i < length; i += 16)
+    {
+      char line[16 * sizeof (",255")];
+      char *p = line;
+      for (size_t j = i; j < length && j < i + 16; j++)
+        p += sprintf (p, j == i ? "%u" : ",%u", (unsigned char) bytes[j]);
+      fprintf (stream, data_bytes, line);
+    }
+}
+
+/* Writes the counters section of the loops in SOURCE, in the order
+   their counters are used.  */
+static void
+write_profile (const ProgramSource *const source, FILE *stream)
+{
+  size_t loops = 0;
+  for (size_t i = 0; i < source->length; i++)
+    if (source->tokens[i].token == T_LABEL)
+      loops++;
 
-  str_append (&output, &output_length, init_variables, DATA_ARRAY_SIZE);
-  str_append (&output, &output_length, init_section_text);
+  fprintf (stream, profile_begin, PROFILE_MAGIC, loops);
+  for (size_t i = 0; i < source->length; i++)
+    if (source->tokens[i].token == T_LABEL)
+      fprintf (stream, profile_loop, source->tokens[i].value);
+  fprintf (stream, profile_end);
+  write_bytes (stream, profile_filename, strlen (profile_filename) + 1);
+}
+
+void
+tokens_to_asm (const ProgramSource *const source, FILE *stream)
+{
+  fprintf (stream, init_array);
+  write_bytes (stream, (const char *) source->tape, source->tape_length);
+  fprintf (stream, init_variables,
+           (unsigned int) (DATA_ARRAY_SIZE - source->tape_length),
+           INPUT_BUFFER_SIZE, output_buffer_size);
+  if (source->output_length != 0)
+    {
+      fprintf (stream, constant_output_begin);
+      write_bytes (stream, source->output, source->output_length);
+    }
+  fprintf (stream, init_section_text);
 
   /* Subroutines for I/O.  */
+  if (source->have_getchar_commands || source->have_putchar_commands)
+    fprintf (stream, flush_body);
   if (source->have_getchar_commands)
-    str_append (&output, &output_length, getchar_body);
+    {
+      fprintf (stream, getchar_body, INPUT_BUFFER_SIZE);
+      if (eof_policy == EOF_ZERO)
+        fprintf (stream, eof_zero);
+      else if (eof_policy == EOF_MINUS_ONE)
+        fprintf (stream, eof_minus_one);
+      fprintf (stream, getchar_fini);
+    }
   if (source->have_putchar_commands)
-    str_append (&output, &output_length, putchar_body);
+    fprintf (stream, putchar_body, output_buffer_size);
 
   /* Execution starts at this point.  */
-  str_append (&output, &output_length, start_init);
+  fprintf (stream, start_init);
+  if (source->have_putchar_commands)
+    fprintf (stream, detect_terminal);
+  if (source->output_length != 0)
+    fprintf (stream, write_constant_output, source->output_length);
+  fprintf (stream, init_pointer, source->start_pointer);
+  if (source->start != 0)
+    fprintf (stream, jump_to_start);
 
   /* Convert tokens to machine code.  */
+  size_t loops = 0;
   for (size_t i = 0; i < source->length; i++)
     {
       const Command current = source->tokens[i];
+      if (i == source->start && source->start != 0)
+        fprintf (stream, start_label);
       switch (current.token)
         {
         case T_INCDEC:
           if (current.value > 0)
-            str_append (&output, &output_length, increment_current_value, +current.value);
+            fprintf (stream, increment_current_value,
+                     +current.value, current.offset);
           else if (current.value < 0)
-            str_append (&output, &output_length, decrement_current_value, -current.value);
+            fprintf (stream, decrement_current_value,
+                     -current.value, current.offset);
           else
             {
               /* Command has no effect.  */
               ;
             }
           break;
+        case T_SET:
+          fprintf (stream, set_current_value,
+                   (u8) current.value, current.offset);
+          break;
+        case T_MULADD:
+          fprintf (stream, load_source_value, current.source_offset);
+          if (current.value == -1)
+            fprintf (stream, subtract_product, current.offset);
+          else
+            {
+              if (current.value != 1)
+                fprintf (stream, multiply_source_value, current.value);
+              fprintf (stream, add_product, current.offset);
+            }
+          break;
         case T_POINTER_INCDEC:
           if (current.value > 0)
-            str_append (&output, &output_length, increment_current_pointer, +current.value);
+            fprintf (stream, increment_current_pointer, +current.value);
           else if (current.value < 0)
-            str_append (&output, &output_length, decrement_current_pointer, -current.value);
+            fprintf (stream, decrement_current_pointer, -current.value);
           else
             {
               /* Command has no effect.  */
               ;
             }
           break;
+        case T_SCAN:
+#if HAVE_VECTOR_SCAN
+          if (scan_mask (current.value) != 0 && current.value > 0)
+            fprintf (stream, scan_right_vector,
+                     DATA_ARRAY_SIZE - 16, i, i, scan_mask (current.value),
+                     i, i, i, i);
+          else if (scan_mask (current.value) != 0)
+            fprintf (stream, scan_left_vector,
+                     i, i, scan_mask (current.value), i, i, i, i);
+#endif
+          fprintf (stream, scan_scalar, i, i, current.value, i, i);
+          break;
         case T_LABEL:
-          str_append (&output, &output_length, label_begin, current.value, current.value);
+          if (profile_filename != NULL)
+            fprintf (stream, count_profile_event,
+                     loops * sizeof (LoopCounters)
+                     + offsetof (LoopCounters, entries));
+          fprintf (stream, label_begin, current.value, current.value);
+          if (profile_filename != NULL)
+            fprintf (stream, count_profile_event,
+                     loops * sizeof (LoopCounters)
+                     + offsetof (LoopCounters, iterations));
+          loops++;
           break;
         case T_JUMP:
-          str_append (&output, &output_length, label_end, current.value, current.value);
+          fprintf (stream, label_end, current.value, current.value);
           break;
         case T_GETCHAR:
-          str_append (&output, &output_length, call_getchar);
+          fprintf (stream, call_getchar);
           break;
         case T_PUTCHAR:
-          str_append (&output, &output_length, call_putchar);
+          fprintf (stream, call_putchar);
           break;
         case T_COMMENT:
         default:
@@ -132,8 +278,192 @@ tokens_to_asm (ProgramSource *const source,
     }
 
   /* Write quit commands.  */
-  str_append (&output, &output_length, start_fini);
+  if (source->have_putchar_commands)
+    fprintf (stream, call_flush);
+  if (profile_filename != NULL)
+    fprintf (stream, dump_profile);
+  fprintf (stream, start_fini);
+
+  if (profile_filename != NULL)
+    write_profile (source, stream);
+}
+
+#if HAVE_ENCODER
+/* Encodes the command I of TOKENS.  LOOPS holds the labels of the
+   loops begun so far.  Scans use the vector loop if VECTOR_SCAN, which
+   needs the pointer to point into the data area.  */
+static void
+encode_command (CodeBuffer *code, const Command *tokens, size_t i,
+                Label *loops, Label getchar_label, Label putchar_label,
+                bool vector_scan)
+{
+  const Command current = tokens[i];
+  switch (current.token)
+    {
+    case T_INCDEC:
+      if (current.value > 0)
+        encode_increment_current_value (code, +current.value, current.offset);
+      else if (current.value < 0)
+        encode_decrement_current_value (code, -current.value, current.offset);
+      break;
+    case T_SET:
+      encode_set_current_value (code, current.value, current.offset);
+      break;
+    case T_MULADD:
+      encode_multiply_add (code, current.value, current.offset,
+                           current.source_offset);
+      break;
+    case T_POINTER_INCDEC:
+      if (current.value > 0)
+        encode_increment_current_pointer (code, +current.value);
+      else if (current.value < 0)
+        encode_decrement_current_pointer (code, -current.value);
+      break;
+    case T_SCAN:
+      encode_scan (code, current.value, vector_scan);
+      break;
+    case T_LABEL:
+      loops[i] = new_label (code);
+      new_label (code);
+      name_label (code, loops[i], ".LB", current.value, false);
+      name_label (code, loops[i] + 1, ".LE", current.value, false);
+      encode_label_begin (code, loops[i], loops[i] + 1);
+      break;
+    case T_JUMP:
+      encode_label_end (code, loops[current.match], loops[current.match] + 1);
+      break;
+    case T_GETCHAR:
+      x86_call (code, getchar_label);
+      break;
+    case T_PUTCHAR:
+      x86_call (code, putchar_label);
+      break;
+    case T_COMMENT:
+    default:
+      break;
+    }
+}
+#endif
+
+bool
+tokens_to_code (const ProgramSource *const source,
+                CodeBuffer *code,
+                bool callable)
+{
+#if HAVE_ENCODER
+  code->data_size = DATA_AREA_SIZE;
+  code->data = source->tape;
+  code->data_length = source->tape_length;
+  name_data (code, "array", ARRAY_OFFSET, DATA_ARRAY_SIZE);
+  name_data (code, "output_length", OUTPUT_LENGTH_OFFSET, 8);
+  name_data (code, "input_position", INPUT_POSITION_OFFSET, 8);
+  name_data (code, "input_length", INPUT_LENGTH_OFFSET, 8);
+  name_data (code, "interactive", INTERACTIVE_OFFSET, 8);
+  name_data (code, "termios", TERMIOS_OFFSET, 64);
+  name_data (code, "input", INPUT_OFFSET, INPUT_BUFFER_SIZE);
+  name_data (code, "output", OUTPUT_OFFSET, output_buffer_size);
+
+  /* Subroutines for I/O.  */
+  const Label flush_label = new_label (code);
+  const Label getchar_label = new_label (code);
+  const Label putchar_label = new_label (code);
+  name_label (code, flush_label, "flush", -1, true);
+  name_label (code, getchar_label, "getchar", -1, true);
+  name_label (code, putchar_label, "putchar", -1, true);
+  if (source->have_getchar_commands || source->have_putchar_commands)
+    {
+      bind_label (code, flush_label);
+      encode_flush_body (code);
+    }
+  if (source->have_getchar_commands)
+    {
+      bind_label (code, getchar_label);
+      encode_getchar_body (code, flush_label);
+    }
+  if (source->have_putchar_commands)
+    {
+      bind_label (code, putchar_label);
+      encode_putchar_body (code, flush_label);
+    }
+
+  /* Execution starts at this point.  */
+  code->entry = new_label (code);
+  name_label (code, code->entry, "_start", -1, true);
+  bind_label (code, code->entry);
+  encode_start_init (code, callable);
+  if (source->have_putchar_commands)
+    encode_detect_terminal (code);
+  const Label output_label = new_label (code);
+  if (source->output_length != 0)
+    encode_write_constant_output (code, output_label, source->output_length);
+  encode_init_pointer (code, source->start_pointer);
+  const Label start_label = new_label (code);
+  if (source->start != 0)
+    x86_jump (code, JUMP_ALWAYS, start_label);
+
+  /* Labels of the loop beginning at each label, its end is the next one.  */
+  Label *loops = xnmalloc (source->length, sizeof (*loops));
+
+  /* Convert tokens to machine code.  */
+  for (size_t i = 0; i < source->length; i++)
+    {
+      if (i == source->start && source->start != 0)
+        bind_label (code, start_label);
+      encode_command (code, source->tokens, i, loops,
+                      getchar_label, putchar_label, true);
+    }
+
+  free (loops);
+
+  /* Write quit commands.  */
+  if (source->have_putchar_commands)
+    x86_call (code, flush_label);
+  encode_start_fini (code, callable);
+
+  /* Constants follow the code.  */
+  if (source->output_length != 0)
+    {
+      name_label (code, output_label, "constant_output", -1, false);
+      bind_label (code, output_label);
+      emit_bytes (code, (const u8 *) source->output, source->output_length);
+    }
+
+  finish_code (code);
 
-  *final_output = output;
-  *final_output_length = output_length;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool
+loop_to_code (const ProgramSource *const source,
+              size_t first,
+              CodeBuffer *code)
+{
+#if HAVE_ENCODER
+  const size_t last = source->tokens[first].match;
+  for (size_t i = first; i <= last; i++)
+    if (source->tokens[i].token == T_GETCHAR
+        || source->tokens[i].token == T_PUTCHAR)
+      return false;
+
+  Label *loops = xnmalloc (source->length, sizeof (*loops));
+
+  /* The pointer comes in %rdi and goes back in %rax.  Nothing else
+     the loop touches has to be preserved.  */
+  code->entry = new_label (code);
+  bind_label (code, code->entry);
+  x86_mov_reg (code, RAX, RDI);
+  for (size_t i = first; i <= last; i++)
+    encode_command (code, source->tokens, i, loops, 0, 0, false);
+  x86_ret (code);
+
+  free (loops);
+  finish_code (code);
+
+  return true;
+#else
+  return false;
+#endif
 }
@@ -19,14 +19,33 @@
 #define _ARCH_H 1
 
 #include <stddef.h>
+#include <stdio.h>
 
+#include "encoder.h"
 #include "tokenizer.h"
 
-/* Compiles tokenized source to assembly source code.  */
-extern void tokens_to_asm (ProgramSource *const source,
-                           char **final_output,
-                           size_t *final_output_length);
-extern int compile_to_obj (char *asm_fn, char *obj_fn);
+/* Name of the target architecture.  */
+extern const char target_name[];
+
+/* Writes assembly source code of tokenized source to STREAM.  */
+extern void tokens_to_asm (const ProgramSource *const source, FILE *stream);
+/* Encodes tokenized source to finished machine code.  Code which is
+   CALLABLE returns to its caller instead of exiting.  Returns false if
+   there is no encoder for this architecture.  */
+extern bool tokens_to_code (const ProgramSource *const source,
+                            CodeBuffer *code,
+                            bool callable);
+/* Encodes the loop which begins at the label FIRST of tokenized source
+   as a function which takes the pointer and returns it at the end of
+   the loop.  Returns false if the loop reads or writes anything, or if
+   there is no encoder for this architecture.  */
+extern bool loop_to_code (const ProgramSource *const source,
+                          size_t first,
+                          CodeBuffer *code);
+/* Assembles ASM_FN to OBJ_FN.  If ASM_FN is NULL, the assembly source
+   code of SOURCE is piped to the assembler instead.  */
+extern int compile_to_obj (char *asm_fn, char *obj_fn,
+                           const ProgramSource *source);
 extern int link_to_elf (char *obj_fn, char *elf_fn, bool with_debug_info);
 
 #endif /* _ARCH_H */
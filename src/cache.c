@@ -0,0 +1,242 @@
+/*  cache.c
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <config.h>
+
+#include "cache.h"
+
+#include <dirent.h>
+#include <error.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "system.h"
+
+#include "filenamecat.h"
+#include "sha256.h"
+#include "xalloc.h"
+
+const char *cache_directory = NULL;
+uintmax_t cache_size_limit = CACHE_SIZE_LIMIT;
+
+void
+cache_key (CacheKey *key, const char *source, size_t length,
+           const char *settings)
+{
+  struct sha256_ctx context;
+  u8 digest[SHA256_DIGEST_SIZE];
+  verify (sizeof (key->name) == 2 * SHA256_DIGEST_SIZE + 1);
+
+  sha256_init_ctx (&context);
+  /* The terminating null keeps settings and source apart.  */
+  sha256_process_bytes (settings, strlen (settings) + 1, &context);
+  sha256_process_bytes (source, length, &context);
+  sha256_finish_ctx (&context, digest);
+
+  for (size_t i = 0; i < SHA256_DIGEST_SIZE; i++)
+    sprintf (&key->name[2 * i], "%02x", digest[i]);
+}
+
+/* Copies the contents of FROM to TO.  */
+static bool
+copy_contents (int from, int to)
+{
+  char buffer[1 << 16];
+  ssize_t length;
+
+  while ((length = read (from, buffer, sizeof (buffer))) != 0)
+    {
+      if (length < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return false;
+        }
+
+      for (ssize_t written = 0; written < length;)
+        {
+          ssize_t res = write (to, buffer + written, length - written);
+          if (res < 0 && errno != EINTR)
+            return false;
+          if (res > 0)
+            written += res;
+        }
+    }
+
+  return true;
+}
+
+/* Copies FROM over TO, with the same permissions.  The copy is made
+   in a temporary file next to TO and renamed to it, so TO is left
+   intact if FROM cannot be read or the copy fails.  */
+static bool
+copy_file (const char *from, const char *to)
+{
+  int from_fd = open (from, O_RDONLY);
+  if (from_fd < 0)
+    return false;
+
+  char *temporary = xmalloc (strlen (to) + sizeof (".XXXXXX"));
+  sprintf (temporary, "%s.XXXXXX", to);
+  int to_fd = mkstemp (temporary);
+  struct stat st;
+
+  bool copied = to_fd >= 0
+                && fstat (from_fd, &st) == 0
+                && fchmod (to_fd, st.st_mode & 0777) == 0
+                && copy_contents (from_fd, to_fd);
+  close (from_fd);
+  if (to_fd >= 0 && close (to_fd) != 0)
+    copied = false;
+  if (copied && rename (temporary, to) != 0)
+    copied = false;
+
+  if (!copied && to_fd >= 0)
+    unlink (temporary);
+  free (temporary);
+
+  return copied;
+}
+
+bool
+cache_fetch (const CacheKey *key, const char *filename)
+{
+  /* The entry is copied rather than linked: the result may be written
+     in place by a later compilation, and the time of the entry is
+     updated below.  */
+  char *entry = file_name_concat (cache_directory, key->name, NULL);
+  bool found = copy_file (entry, filename);
+
+  /* The modification time of an entry is the time it was used last.  */
+  if (found)
+    utimensat (AT_FDCWD, entry, NULL, 0);
+
+  free (entry);
+  return found;
+}
+
+typedef struct
+{
+  char *name;
+  struct timespec used;
+  off_t size;
+} CacheEntry;
+
+static int
+compare_use_times (const void *a, const void *b)
+{
+  const CacheEntry *x = a;
+  const CacheEntry *y = b;
+
+  if (x->used.tv_sec != y->used.tv_sec)
+    return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+  if (x->used.tv_nsec != y->used.tv_nsec)
+    return x->used.tv_nsec < y->used.tv_nsec ? -1 : 1;
+  return 0;
+}
+
+/* Removes the least recently used entries until the cache takes no
+   more than cache_size_limit bytes.  */
+static void
+evict_entries (void)
+{
+  DIR *dir = opendir (cache_directory);
+  if (dir == NULL)
+    return;
+
+  CacheEntry *entries = NULL;
+  size_t entries_length = 0;
+  size_t entries_allocated = 0;
+  uintmax_t total_size = 0;
+
+  struct dirent *dirent;
+  while ((dirent = readdir (dir)) != NULL)
+    {
+      struct stat st;
+      if (strlen (dirent->d_name) != 2 * SHA256_DIGEST_SIZE
+          || fstatat (dirfd (dir), dirent->d_name, &st, 0) != 0)
+        continue;
+
+      if (entries_length == entries_allocated)
+        entries = x2nrealloc (entries, &entries_allocated, sizeof (*entries));
+      entries[entries_length].name = xstrdup (dirent->d_name);
+      entries[entries_length].used = st.st_mtim;
+      entries[entries_length].size = st.st_size;
+      entries_length++;
+      total_size += st.st_size;
+    }
+
+  if (total_size > cache_size_limit)
+    {
+      qsort (entries, entries_length, sizeof (*entries), compare_use_times);
+      for (size_t i = 0; i < entries_length && total_size > cache_size_limit; i++)
+        if (unlinkat (dirfd (dir), entries[i].name, 0) == 0)
+          total_size -= entries[i].size;
+    }
+
+  for (size_t i = 0; i < entries_length; i++)
+    free (entries[i].name);
+  free (entries);
+  closedir (dir);
+}
+
+void
+cache_store (const CacheKey *key, const char *filename)
+{
+  if (mkdir (cache_directory, 0777) != 0 && errno != EEXIST)
+    {
+      error (0, errno, "%s", quotef (cache_directory));
+      return;
+    }
+
+  /* The entry appears at once, so that concurrent compilations never
+     see it half written.  */
+  char *temporary = file_name_concat (cache_directory, "tmp.XXXXXX", NULL);
+  char *entry = file_name_concat (cache_directory, key->name, NULL);
+  int to_fd = mkstemp (temporary);
+  int from_fd = open (filename, O_RDONLY);
+  struct stat st;
+
+  bool stored = to_fd >= 0 && from_fd >= 0
+                && fstat (from_fd, &st) == 0
+                && fchmod (to_fd, st.st_mode & 0777) == 0
+                && copy_contents (from_fd, to_fd);
+  if (from_fd >= 0)
+    close (from_fd);
+  if (to_fd >= 0 && close (to_fd) != 0)
+    stored = false;
+  if (stored && rename (temporary, entry) != 0)
+    stored = false;
+
+  if (!stored)
+    {
+      error (0, errno, _("warning: cannot cache %s"), quotef (filename));
+      if (to_fd >= 0)
+        unlink (temporary);
+    }
+
+  free (entry);
+  free (temporary);
+
+  if (stored)
+    evict_entries ();
+}
@@ -0,0 +1,61 @@
+/*  cache.h
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _CACHE_H
+#define _CACHE_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "system.h"
+
+/* Default maximum size of the files in the cache.  */
+#define CACHE_SIZE_LIMIT (256 << 20)
+
+/* Directory of the compilation cache, NULL if it is disabled.  */
+extern const char *cache_directory;
+
+/* Maximum size of the files in the cache, in bytes.  */
+extern uintmax_t cache_size_limit;
+
+/* Name of the cache entry of one compilation, the SHA-256 of its
+   source and settings in hex.  */
+typedef struct
+{
+  char name[2 * 32 + 1];
+} CacheKey;
+
+/* Computes the KEY of compiling LENGTH bytes of SOURCE, with comments
+   stripped, with SETTINGS, which names everything else that changes
+   the result.  */
+extern void cache_key (CacheKey *key,
+                       const char *source,
+                       size_t length,
+                       const char *settings)
+  __nonnull ((1, 2, 4));
+
+/* Replaces FILENAME by a copy of the cached result of KEY and marks
+   the entry as just used.  Returns false if there is no such result.  */
+extern bool cache_fetch (const CacheKey *key, const char *filename)
+  __nonnull ((1, 2));
+
+/* Copies FILENAME to the cache as the result of KEY, then evicts the
+   least recently used entries above cache_size_limit.  */
+extern void cache_store (const CacheKey *key, const char *filename)
+  __nonnull ((1, 2));
+
+#endif /* _CACHE_H */
@@ -0,0 +1,307 @@
+/*  classify.c
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include <config.h>
+
+#include "classify.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "system.h"
+
+#include "tokenizer.h"
+
+/* The source is scanned in blocks of 16 or 32 bytes where the CPU
+   allows it.  Which implementation is used is decided at run time,
+   on the first call.  */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define HAVE_X86_SIMD 1
+# include <immintrin.h>
+#else
+# define HAVE_X86_SIMD 0
+#endif
+
+static size_t
+strip_tail (char *s, size_t i, size_t j, size_t length)
+{
+  for (; i < length; i++)
+    if (parse_token (s[i]) != T_COMMENT)
+      s[j++] = s[i];
+  return j;
+}
+
+static size_t
+fold_tail (const char *s, size_t i, size_t length, i64 *value)
+{
+  const Token token = parse_token (s[0]);
+  i64 sum = *value;
+
+  for (; i < length && parse_token (s[i]) == token; i++)
+    sum += parse_value (s[i]);
+
+  *value = sum;
+  return i;
+}
+
+static size_t
+strip_scalar (char *s, size_t length)
+{
+  return strip_tail (s, 0, 0, length);
+}
+
+static size_t
+fold_scalar (const char *s, size_t length, i64 *value)
+{
+  *value = 0;
+  return fold_tail (s, 0, length, value);
+}
+
+#if HAVE_X86_SIMD
+/* Commands are recognized by two table lookups: the low nibble of a
+   byte selects the set of high nibbles it forms a command with:
+   '+' 0x2b, ',' 0x2c, '-' 0x2d, '.' 0x2e,
+   '<' 0x3c, '>' 0x3e, '[' 0x5b, ']' 0x5d.  */
+# define LOW_NIBBLE_TABLE \
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1|4, 1|2, 1|4, 1|2, 0
+# define HIGH_NIBBLE_TABLE \
+  0, 0, 1, 2, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+
+/* Shuffle which moves the bytes selected by the index to the beginning
+   of an 8-byte group.  */
+static u8 compact_shuffle[0400][8];
+
+static void
+init_compact_shuffle (void)
+{
+  for (unsigned int mask = 0; mask < countof (compact_shuffle); mask++)
+    {
+      unsigned int k = 0;
+      for (unsigned int bit = 0; bit < 8; bit++)
+        if (mask & (1U << bit))
+          compact_shuffle[mask][k++] = bit;
+      while (k < 8)
+        compact_shuffle[mask][k++] = 0x80;
+    }
+}
+
+__attribute__ ((__target__ ("ssse3")))
+static inline size_t
+compact_ssse3 (char *s, size_t j, __m128i v, unsigned int mask)
+{
+  __m128i shuffle;
+
+  shuffle = _mm_loadl_epi64 ((const __m128i *) compact_shuffle[mask & 0xff]);
+  _mm_storel_epi64 ((__m128i *) (s + j), _mm_shuffle_epi8 (v, shuffle));
+  j += __builtin_popcount (mask & 0xff);
+
+  shuffle = _mm_loadl_epi64 ((const __m128i *) compact_shuffle[mask >> 8]);
+  _mm_storel_epi64 ((__m128i *) (s + j), _mm_shuffle_epi8 (_mm_srli_si128 (v, 8), shuffle));
+  j += __builtin_popcount (mask >> 8);
+
+  return j;
+}
+
+/* Compacted bytes are always stored at or before the block they were
+   loaded from, so the source can be stripped in place.  */
+__attribute__ ((__target__ ("ssse3")))
+static size_t
+strip_ssse3 (char *s, size_t length)
+{
+  const __m128i low_table = _mm_setr_epi8 (LOW_NIBBLE_TABLE);
+  const __m128i high_table = _mm_setr_epi8 (HIGH_NIBBLE_TABLE);
+  const __m128i nibble = _mm_set1_epi8 (0x0f);
+  const __m128i zero = _mm_setzero_si128 ();
+
+  size_t i = 0;
+  size_t j = 0;
+  for (; i + 16 <= length; i += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (s + i));
+      __m128i low = _mm_shuffle_epi8 (low_table, _mm_and_si128 (v, nibble));
+      __m128i high = _mm_shuffle_epi8 (high_table, _mm_and_si128 (_mm_srli_epi16 (v, 4), nibble));
+      unsigned int mask = _mm_movemask_epi8 (_mm_cmpgt_epi8 (_mm_and_si128 (low, high), zero));
+
+      if (mask == 0xffff)
+        {
+          _mm_storeu_si128 ((__m128i *) (s + j), v);
+          j += 16;
+        }
+      else if (mask != 0)
+        j = compact_ssse3 (s, j, v, mask);
+    }
+
+  return strip_tail (s, i, j, length);
+}
+
+__attribute__ ((__target__ ("avx2,popcnt")))
+static size_t
+strip_avx2 (char *s, size_t length)
+{
+  const __m256i low_table = _mm256_setr_epi8 (LOW_NIBBLE_TABLE, LOW_NIBBLE_TABLE);
+  const __m256i high_table = _mm256_setr_epi8 (HIGH_NIBBLE_TABLE, HIGH_NIBBLE_TABLE);
+  const __m256i nibble = _mm256_set1_epi8 (0x0f);
+  const __m256i zero = _mm256_setzero_si256 ();
+
+  size_t i = 0;
+  size_t j = 0;
+  for (; i + 32 <= length; i += 32)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) (s + i));
+      __m256i low = _mm256_shuffle_epi8 (low_table, _mm256_and_si256 (v, nibble));
+      __m256i high = _mm256_shuffle_epi8 (high_table, _mm256_and_si256 (_mm256_srli_epi16 (v, 4), nibble));
+      u32 mask = _mm256_movemask_epi8 (_mm256_cmpgt_epi8 (_mm256_and_si256 (low, high), zero));
+
+      if (mask == UINT32_MAX)
+        {
+          _mm256_storeu_si256 ((__m256i *) (s + j), v);
+          j += 32;
+        }
+      else if (mask != 0)
+        {
+          j = compact_ssse3 (s, j, _mm256_castsi256_si128 (v), mask & 0xffff);
+          j = compact_ssse3 (s, j, _mm256_extracti128_si256 (v, 1), mask >> 16);
+        }
+    }
+
+  return strip_tail (s, i, j, length);
+}
+
+__attribute__ ((__target__ ("sse2")))
+static size_t
+fold_sse2 (const char *s, size_t length, i64 *value)
+{
+  const bool data = parse_token (s[0]) == T_INCDEC;
+  const __m128i up = _mm_set1_epi8 (data ? '+' : '>');
+  const __m128i down = _mm_set1_epi8 (data ? '-' : '<');
+
+  i64 sum = 0;
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (s + i));
+      unsigned int up_mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, up));
+      unsigned int down_mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, down));
+      unsigned int run = up_mask | down_mask;
+
+      if (run != 0xffff)
+        {
+          /* The run ends inside of this block.  */
+          unsigned int n = __builtin_ctz (~run);
+          unsigned int in_run = (1U << n) - 1;
+          sum += __builtin_popcount (up_mask & in_run);
+          sum -= __builtin_popcount (down_mask & in_run);
+          *value = sum;
+          return i + n;
+        }
+
+      sum += __builtin_popcount (up_mask);
+      sum -= __builtin_popcount (down_mask);
+    }
+
+  *value = sum;
+  return fold_tail (s, i, length, value);
+}
+
+__attribute__ ((__target__ ("avx2,popcnt")))
+static size_t
+fold_avx2 (const char *s, size_t length, i64 *value)
+{
+  const bool data = parse_token (s[0]) == T_INCDEC;
+  const __m256i up = _mm256_set1_epi8 (data ? '+' : '>');
+  const __m256i down = _mm256_set1_epi8 (data ? '-' : '<');
+
+  i64 sum = 0;
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) (s + i));
+      u32 up_mask = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, up));
+      u32 down_mask = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, down));
+      u32 run = up_mask | down_mask;
+
+      if (run != UINT32_MAX)
+        {
+          /* The run ends inside of this block.  */
+          unsigned int n = __builtin_ctz (~run);
+          u32 in_run = (UINT32_C (1) << n) - 1;
+          sum += __builtin_popcount (up_mask & in_run);
+          sum -= __builtin_popcount (down_mask & in_run);
+          *value = sum;
+          return i + n;
+        }
+
+      sum += __builtin_popcount (up_mask);
+      sum -= __builtin_popcount (down_mask);
+    }
+
+  *value = sum;
+  return fold_tail (s, i, length, value);
+}
+#endif /* HAVE_X86_SIMD */
+
+static size_t (*strip_implementation) (char *, size_t);
+static size_t (*fold_implementation) (const char *, size_t, i64 *);
+
+static void
+select_implementation (void)
+{
+  size_t (*strip) (char *, size_t) = strip_scalar;
+  size_t (*fold) (const char *, size_t, i64 *) = fold_scalar;
+
+#if HAVE_X86_SIMD
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("popcnt"))
+    {
+      strip = strip_avx2;
+      fold = fold_avx2;
+    }
+  else
+    {
+      if (__builtin_cpu_supports ("ssse3"))
+        strip = strip_ssse3;
+      if (__builtin_cpu_supports ("sse2"))
+        fold = fold_sse2;
+    }
+
+  if (strip != strip_scalar)
+    init_compact_shuffle ();
+#endif
+
+  fold_implementation = fold;
+  strip_implementation = strip;
+}
+
+size_t
+strip_non_commands (char *source, size_t length)
+{
+  if (strip_implementation == NULL)
+    select_implementation ();
+
+  return strip_implementation (source, length);
+}
+
+size_t
+fold_run (const char *source, size_t length, i64 *value)
+{
+  if (fold_implementation == NULL)
+    select_implementation ();
+
+  return fold_implementation (source, length, value);
+}
@@ -0,0 +1,36 @@
+/*  classify.h
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#ifndef _CLASSIFY_H
+#define _CLASSIFY_H 1
+
+#include <stddef.h>
+
+#include "system.h"
+
+/* Move all BrainFuck commands of SOURCE to its beginning, dropping any
+   other characters.  Return the number of commands kept.  */
+extern size_t strip_non_commands (char *source, size_t length)
+  __nonnull ((1));
+
+/* Sum the values of the run of '+' and '-' (or '>' and '<') commands
+   SOURCE starts with into *VALUE.  Return the length of the run.  */
+extern size_t fold_run (const char *source, size_t length, i64 *value)
+  __nonnull ((1, 3));
+
+#endif /* _CLASSIFY_H */
@@ -33,35 +33,18 @@
 #include "die.h"
 #include "xalloc.h"
 
-void
-str_append (char **str, size_t *length, const char *format, ...)
-{
-  /* This is only used to combine arguments,
-     so fixed-size string should be safe to use.  */
-  char formatted_str[384];
-  assert (strlen (format) <= sizeof (formatted_str));
-
-  va_list argp;
-  va_start (argp, format);
-  int err = vsprintf (formatted_str, format, argp);
-  va_end (argp);
-
-  if (err < 0)
-    die (EXIT_FAILURE, errno, "vsprintf()");
-
-  size_t formatted_str_len = strlen (formatted_str);
-  *str = xrealloc (*str, *length + formatted_str_len + 1);
-  strcpy (*str + *length, formatted_str);
-  *length += formatted_str_len;
-}
+unsigned int output_buffer_size = OUTPUT_BUFFER_SIZE;
+EofPolicy eof_policy = EOF_UNCHANGED;
+const char *profile_filename = NULL;
 
-static int
+int
 write_file (const char *filename,
             const char *source,
-            const size_t source_length)
+            const size_t source_length,
+            mode_t mode)
 {
   int fd;
-  if ((fd = open (filename, O_WRONLY)) >= 0)
+  if ((fd = open (filename, O_WRONLY|O_CREAT|O_TRUNC, mode)) >= 0)
     {
       const char *begin = source;
       const char *const end = begin + source_length;
@@ -99,10 +82,24 @@ int
 translate_to_asm (const char *filename,
                   ProgramSource *const source)
 {
-  char *instructions = NULL;
-  size_t instructions_length = 0;
-  tokens_to_asm (source, &instructions, &instructions_length);
-  int err = write_file (filename, instructions, instructions_length);
-  free (instructions);
-  return err;
+  FILE *stream = fopen (filename, "w");
+  if (stream == NULL)
+    {
+      error (0, errno, "%s", quotef (filename));
+      return -1;
+    }
+
+  /* The code is written as it is generated, so memory use does not
+     depend on the size of the program.  */
+  setvbuf (stream, NULL, _IOFBF, ASM_BUFFER_SIZE);
+  tokens_to_asm (source, stream);
+
+  bool failed = ferror (stream) != 0;
+  if (fclose (stream) != 0 || failed)
+    {
+      error (0, errno, "%s", quotef (filename));
+      return -1;
+    }
+
+  return 0;
 }
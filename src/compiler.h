@@ -18,6 +18,8 @@
 #ifndef _COMPILER_H
 #define _COMPILER_H 1
 
+#include <sys/types.h>
+
 #include "tokenizer.h"
 
 #include "system.h"
@@ -25,8 +27,40 @@
 /* Maximum size of the data array by BrainFuck std.  */
 #define DATA_ARRAY_SIZE 30000
 
-extern void str_append (char **str, size_t *length, const char *format, ...)
-  __attribute__ ((__format__ (__printf__, 3, 4), __nonnull__ (1, 2, 3)));
+/* Default size of the buffer of the program output.  */
+#define OUTPUT_BUFFER_SIZE 4096
+
+/* Size of the buffer of the program output, 1 writes every byte
+   at once.  */
+extern unsigned int output_buffer_size;
+
+/* Size of the buffer of the program input.  */
+#define INPUT_BUFFER_SIZE 4096
+
+/* What ',' does with the current cell at the end of input.  */
+typedef enum
+{
+  EOF_UNCHANGED,
+  EOF_ZERO,
+  EOF_MINUS_ONE
+} EofPolicy;
+
+extern EofPolicy eof_policy;
+
+/* File the compiled program writes its loop counters to at exit, NULL
+   if it is not profiled.  */
+extern const char *profile_filename;
+
+/* Size of the buffer assembly source code is written through.  */
+#define ASM_BUFFER_SIZE (1 << 16)
+
+/* Writes SOURCE_LENGTH bytes of SOURCE to FILENAME, creating it with
+   MODE if it does not exist.  */
+extern int write_file (const char *filename,
+                       const char *source,
+                       const size_t source_length,
+                       mode_t mode)
+  __attribute__ ((__nonnull__ (1, 2)));
 
 /* Compiles tokenized source to executable.  */
 extern int translate_to_asm (const char *filename,
@@ -0,0 +1,586 @@
+/*  encoder.c
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include <config.h>
+
+#include "encoder.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system.h"
+
+#include "xalloc.h"
+
+void
+init_code (CodeBuffer *code)
+{
+  memset (code, 0, sizeof (*code));
+}
+
+void
+free_code (CodeBuffer *code)
+{
+  free (code->bytes);
+  free (code->labels);
+  free (code->jumps);
+  free (code->references);
+  free (code->label_references);
+  free (code->data_symbols);
+  init_code (code);
+}
+
+static CodePosition
+current_position (const CodeBuffer *code)
+{
+  CodePosition where = { code->length, code->jumps_length };
+  return where;
+}
+
+void
+emit_bytes (CodeBuffer *code, const u8 *bytes, size_t n)
+{
+  while (code->alloc - code->length < n)
+    code->bytes = x2nrealloc (code->bytes, &code->alloc, sizeof (*code->bytes));
+  memcpy (code->bytes + code->length, bytes, n);
+  code->length += n;
+}
+
+static void
+emit_u8 (CodeBuffer *code, u8 value)
+{
+  emit_bytes (code, &value, 1);
+}
+
+static void
+emit_u32 (CodeBuffer *code, u32 value)
+{
+  const u8 bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+  emit_bytes (code, bytes, sizeof (bytes));
+}
+
+Label
+new_label (CodeBuffer *code)
+{
+  if (code->labels_length == code->labels_alloc)
+    code->labels = x2nrealloc (code->labels, &code->labels_alloc,
+                               sizeof (*code->labels));
+  code->labels[code->labels_length].bound = false;
+  code->labels[code->labels_length].name = NULL;
+  return code->labels_length++;
+}
+
+void
+name_label (CodeBuffer *code, Label label,
+            const char *name, i32 index, bool function)
+{
+  assert (label < code->labels_length);
+  code->labels[label].name = name;
+  code->labels[label].index = index;
+  code->labels[label].function = function;
+}
+
+void
+name_data (CodeBuffer *code, const char *name, u32 offset, u32 size)
+{
+  if (code->data_symbols_length == code->data_symbols_alloc)
+    code->data_symbols = x2nrealloc (code->data_symbols, &code->data_symbols_alloc,
+                                     sizeof (*code->data_symbols));
+  code->data_symbols[code->data_symbols_length].name = name;
+  code->data_symbols[code->data_symbols_length].offset = offset;
+  code->data_symbols[code->data_symbols_length].size = size;
+  code->data_symbols_length++;
+}
+
+void
+bind_label (CodeBuffer *code, Label label)
+{
+  assert (label < code->labels_length && !code->labels[label].bound);
+  code->labels[label].where = current_position (code);
+  code->labels[label].bound = true;
+}
+
+size_t
+label_offset (const CodeBuffer *code, Label label)
+{
+  assert (label < code->labels_length && code->labels[label].bound);
+  return code->labels[label].where.position;
+}
+
+/* REX prefix, emitted only when it is needed: for 64-bit operand size,
+   for extended registers, or to address %spl-%dil instead of %ah-%bh.  */
+static void
+emit_rex (CodeBuffer *code, bool wide, unsigned int reg,
+          unsigned int base, bool byte_register)
+{
+  u8 rex = 0x40;
+  if (wide)
+    rex |= 0x08;
+  if (reg & 8)
+    rex |= 0x04;
+  if (base & 8)
+    rex |= 0x01;
+  if (rex != 0x40 || (byte_register && reg >= RSP && reg <= RDI))
+    emit_u8 (code, rex);
+}
+
+/* ModRM (and SIB, displacement) for register or /digit REG and the
+   MEMORY operand, followed by IMMEDIATE_SIZE bytes of immediate.  */
+static void
+emit_memory (CodeBuffer *code, unsigned int reg, Memory memory,
+             u8 immediate_size)
+{
+  const u8 reg_field = (reg & 7) << 3;
+
+  if (memory.data)
+    {
+      /* mod = 00, rm = 101: disp32(%rip).  */
+      emit_u8 (code, reg_field | 0x05);
+      if (code->references_length == code->references_alloc)
+        code->references = x2nrealloc (code->references, &code->references_alloc,
+                                       sizeof (*code->references));
+      code->references[code->references_length].where = current_position (code);
+      code->references[code->references_length].data_offset = memory.displacement;
+      code->references[code->references_length].immediate_size = immediate_size;
+      code->references_length++;
+      emit_u32 (code, 0);
+      return;
+    }
+
+  const u8 base = memory.base & 7;
+  const i32 displacement = memory.displacement;
+  u8 mod;
+  if (displacement == 0 && base != RBP)
+    mod = 0x00;
+  else if (displacement >= INT8_MIN && displacement <= INT8_MAX)
+    mod = 0x40;
+  else
+    mod = 0x80;
+
+  emit_u8 (code, mod | reg_field | base);
+  if (base == RSP)
+    /* SIB without index.  */
+    emit_u8 (code, 0x24);
+  if (mod == 0x40)
+    emit_u8 (code, displacement);
+  else if (mod == 0x80)
+    emit_u32 (code, displacement);
+}
+
+void
+x86_push (CodeBuffer *code, Register reg)
+{
+  emit_rex (code, false, 0, reg, false);
+  emit_u8 (code, 0x50 + (reg & 7));
+}
+
+void
+x86_pop (CodeBuffer *code, Register reg)
+{
+  emit_rex (code, false, 0, reg, false);
+  emit_u8 (code, 0x58 + (reg & 7));
+}
+
+void
+x86_ret (CodeBuffer *code)
+{
+  emit_u8 (code, 0xc3);
+}
+
+void
+x86_syscall (CodeBuffer *code)
+{
+  static const u8 syscall[] = { 0x0f, 0x05 };
+  emit_bytes (code, syscall, sizeof (syscall));
+}
+
+void
+x86_mov_imm32 (CodeBuffer *code, Register reg, u32 immediate)
+{
+  emit_rex (code, false, 0, reg, false);
+  emit_u8 (code, 0xb8 + (reg & 7));
+  emit_u32 (code, immediate);
+}
+
+void
+x86_mov_reg (CodeBuffer *code, Register dst, Register src)
+{
+  emit_rex (code, true, src, dst, false);
+  emit_u8 (code, 0x89);
+  emit_u8 (code, 0xc0 | ((src & 7) << 3) | (dst & 7));
+}
+
+void
+x86_alu_reg (CodeBuffer *code, AluOperation operation,
+             Register dst, Register src)
+{
+  emit_rex (code, true, src, dst, false);
+  /* ADD r/m64,r64 and the others of the group are 8 apart.  */
+  emit_u8 (code, (operation << 3) | 0x01);
+  emit_u8 (code, 0xc0 | ((src & 7) << 3) | (dst & 7));
+}
+
+void
+x86_alu_imm (CodeBuffer *code, AluOperation operation,
+             Register reg, i32 immediate)
+{
+  emit_rex (code, true, 0, reg, false);
+  if (immediate >= INT8_MIN && immediate <= INT8_MAX)
+    {
+      emit_u8 (code, 0x83);
+      emit_u8 (code, 0xc0 | (operation << 3) | (reg & 7));
+      emit_u8 (code, immediate);
+    }
+  else
+    {
+      emit_u8 (code, 0x81);
+      emit_u8 (code, 0xc0 | (operation << 3) | (reg & 7));
+      emit_u32 (code, immediate);
+    }
+}
+
+void
+x86_alu_mem8_imm (CodeBuffer *code, AluOperation operation,
+                  Memory memory, u8 immediate)
+{
+  emit_rex (code, false, 0, memory.data ? 0 : memory.base, false);
+  emit_u8 (code, 0x80);
+  emit_memory (code, operation, memory, 1);
+  emit_u8 (code, immediate);
+}
+
+void
+x86_alu_mem8_reg (CodeBuffer *code, AluOperation operation,
+                  Memory memory, Register reg)
+{
+  emit_rex (code, false, reg, memory.data ? 0 : memory.base, true);
+  /* ADD r/m8,r8 and the others of the group are 8 apart.  */
+  emit_u8 (code, operation << 3);
+  emit_memory (code, reg, memory, 0);
+}
+
+void
+x86_imul_imm (CodeBuffer *code, Register dst, Register src, i32 immediate)
+{
+  emit_rex (code, false, dst, src, false);
+  if (immediate >= INT8_MIN && immediate <= INT8_MAX)
+    {
+      emit_u8 (code, 0x6b);
+      emit_u8 (code, 0xc0 | ((dst & 7) << 3) | (src & 7));
+      emit_u8 (code, immediate);
+    }
+  else
+    {
+      emit_u8 (code, 0x69);
+      emit_u8 (code, 0xc0 | ((dst & 7) << 3) | (src & 7));
+      emit_u32 (code, immediate);
+    }
+}
+
+void
+x86_bsf (CodeBuffer *code, Register dst, Register src)
+{
+  static const u8 bsf[] = { 0x0f, 0xbc };
+  emit_rex (code, true, dst, src, false);
+  emit_bytes (code, bsf, sizeof (bsf));
+  emit_u8 (code, 0xc0 | ((dst & 7) << 3) | (src & 7));
+}
+
+void
+x86_bsr (CodeBuffer *code, Register dst, Register src)
+{
+  static const u8 bsr[] = { 0x0f, 0xbd };
+  emit_rex (code, true, dst, src, false);
+  emit_bytes (code, bsr, sizeof (bsr));
+  emit_u8 (code, 0xc0 | ((dst & 7) << 3) | (src & 7));
+}
+
+void
+x86_test (CodeBuffer *code, Register dst, Register src)
+{
+  emit_rex (code, true, src, dst, false);
+  emit_u8 (code, 0x85);
+  emit_u8 (code, 0xc0 | ((src & 7) << 3) | (dst & 7));
+}
+
+void
+x86_load64 (CodeBuffer *code, Register reg, Memory memory)
+{
+  emit_rex (code, true, reg, memory.data ? 0 : memory.base, false);
+  emit_u8 (code, 0x8b);
+  emit_memory (code, reg, memory, 0);
+}
+
+void
+x86_store64 (CodeBuffer *code, Memory memory, Register reg)
+{
+  emit_rex (code, true, reg, memory.data ? 0 : memory.base, false);
+  emit_u8 (code, 0x89);
+  emit_memory (code, reg, memory, 0);
+}
+
+void
+x86_store64_imm (CodeBuffer *code, Memory memory, i32 immediate)
+{
+  emit_rex (code, true, 0, memory.data ? 0 : memory.base, false);
+  emit_u8 (code, 0xc7);
+  emit_memory (code, 0, memory, 4);
+  emit_u32 (code, immediate);
+}
+
+void
+x86_load8 (CodeBuffer *code, Register reg, Memory memory)
+{
+  emit_rex (code, false, reg, memory.data ? 0 : memory.base, true);
+  emit_u8 (code, 0x8a);
+  emit_memory (code, reg, memory, 0);
+}
+
+void
+x86_store8 (CodeBuffer *code, Memory memory, Register reg)
+{
+  emit_rex (code, false, reg, memory.data ? 0 : memory.base, true);
+  emit_u8 (code, 0x88);
+  emit_memory (code, reg, memory, 0);
+}
+
+void
+x86_store8_imm (CodeBuffer *code, Memory memory, u8 immediate)
+{
+  emit_rex (code, false, 0, memory.data ? 0 : memory.base, false);
+  emit_u8 (code, 0xc6);
+  emit_memory (code, 0, memory, 1);
+  emit_u8 (code, immediate);
+}
+
+void
+x86_load8_zero_extend (CodeBuffer *code, Register reg, Memory memory)
+{
+  static const u8 movzbl[] = { 0x0f, 0xb6 };
+  emit_rex (code, false, reg, memory.data ? 0 : memory.base, false);
+  emit_bytes (code, movzbl, sizeof (movzbl));
+  emit_memory (code, reg, memory, 0);
+}
+
+void
+x86_lea (CodeBuffer *code, Register reg, Memory memory)
+{
+  emit_rex (code, true, reg, memory.data ? 0 : memory.base, false);
+  emit_u8 (code, 0x8d);
+  emit_memory (code, reg, memory, 0);
+}
+
+/* SSE instruction 0F OPCODE with the mandatory PREFIX and register
+   operands.  */
+static void
+emit_sse_reg (CodeBuffer *code, u8 prefix, u8 opcode,
+              unsigned int reg, unsigned int rm)
+{
+  emit_u8 (code, prefix);
+  emit_rex (code, false, reg, rm, false);
+  emit_u8 (code, 0x0f);
+  emit_u8 (code, opcode);
+  emit_u8 (code, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+void
+x86_pxor (CodeBuffer *code, XmmRegister dst, XmmRegister src)
+{
+  emit_sse_reg (code, 0x66, 0xef, dst, src);
+}
+
+void
+x86_pcmpeqb (CodeBuffer *code, XmmRegister dst, XmmRegister src)
+{
+  emit_sse_reg (code, 0x66, 0x74, dst, src);
+}
+
+void
+x86_movdqu_load (CodeBuffer *code, XmmRegister dst, Memory memory)
+{
+  emit_u8 (code, 0xf3);
+  emit_rex (code, false, dst, memory.data ? 0 : memory.base, false);
+  emit_u8 (code, 0x0f);
+  emit_u8 (code, 0x6f);
+  emit_memory (code, dst, memory, 0);
+}
+
+void
+x86_pmovmskb (CodeBuffer *code, Register dst, XmmRegister src)
+{
+  emit_sse_reg (code, 0x66, 0xd7, dst, src);
+}
+
+void
+x86_lea_label (CodeBuffer *code, Register reg, Label label)
+{
+  emit_rex (code, true, reg, 0, false);
+  emit_u8 (code, 0x8d);
+  /* mod = 00, rm = 101: disp32(%rip).  */
+  emit_u8 (code, ((reg & 7) << 3) | 0x05);
+  if (code->label_references_length == code->label_references_alloc)
+    code->label_references = x2nrealloc (code->label_references,
+                                         &code->label_references_alloc,
+                                         sizeof (*code->label_references));
+  code->label_references[code->label_references_length].where = current_position (code);
+  code->label_references[code->label_references_length].target = label;
+  code->label_references_length++;
+  emit_u32 (code, 0);
+}
+
+void
+x86_jump (CodeBuffer *code, int condition, Label label)
+{
+  if (code->jumps_length == code->jumps_alloc)
+    code->jumps = x2nrealloc (code->jumps, &code->jumps_alloc,
+                              sizeof (*code->jumps));
+  CodeJump *jump = &code->jumps[code->jumps_length];
+  jump->where = current_position (code);
+  jump->target = label;
+  jump->kind = condition;
+  /* Calls have no short form.  */
+  jump->wide = condition == JUMP_CALL;
+  code->jumps_length++;
+}
+
+void
+x86_call (CodeBuffer *code, Label label)
+{
+  x86_jump (code, JUMP_CALL, label);
+}
+
+static size_t
+jump_size (const CodeJump *jump)
+{
+  if (!jump->wide)
+    return 2;
+  return jump->kind == JUMP_ALWAYS || jump->kind == JUMP_CALL ? 5 : 6;
+}
+
+void
+finish_code (CodeBuffer *code)
+{
+  const size_t n = code->jumps_length;
+
+  /* SHIFT[I] is the size of the first I jumps, so the final offset of
+     a position is its offset in the raw bytes plus the shift.  */
+  size_t *shift = xnmalloc (n + 1, sizeof (*shift));
+
+  /* Start with all jumps short and widen those which do not reach
+     their labels until nothing changes.  Jumps only grow, so this
+     terminates.  */
+  bool changed;
+  do
+    {
+      shift[0] = 0;
+      for (size_t i = 0; i < n; i++)
+        shift[i + 1] = shift[i] + jump_size (&code->jumps[i]);
+
+      changed = false;
+      for (size_t i = 0; i < n; i++)
+        {
+          CodeJump *jump = &code->jumps[i];
+          if (jump->wide)
+            continue;
+
+          const CodeLabel *label = &code->labels[jump->target];
+          assert (label->bound);
+          const ptrdiff_t end = jump->where.position + shift[i + 1];
+          const ptrdiff_t target = label->where.position + shift[label->where.jumps_before];
+          const ptrdiff_t displacement = target - end;
+          if (displacement < INT8_MIN || displacement > INT8_MAX)
+            {
+              jump->wide = true;
+              changed = true;
+            }
+        }
+    }
+  while (changed);
+
+  u8 *bytes = xmalloc (code->length + shift[n] + 1);
+  size_t length = 0;
+  size_t copied = 0;
+  for (size_t i = 0; i < n; i++)
+    {
+      const CodeJump *jump = &code->jumps[i];
+      memcpy (bytes + length, code->bytes + copied, jump->where.position - copied);
+      length += jump->where.position - copied;
+      copied = jump->where.position;
+
+      const CodeLabel *label = &code->labels[jump->target];
+      const size_t target = label->where.position + shift[label->where.jumps_before];
+      const size_t end = length + jump_size (jump);
+      const u32 displacement = target - end;
+
+      if (!jump->wide)
+        bytes[length++] = jump->kind == JUMP_ALWAYS ? 0xeb : 0x70 + jump->kind;
+      else if (jump->kind == JUMP_ALWAYS)
+        bytes[length++] = 0xe9;
+      else if (jump->kind == JUMP_CALL)
+        bytes[length++] = 0xe8;
+      else
+        {
+          bytes[length++] = 0x0f;
+          bytes[length++] = 0x80 + jump->kind;
+        }
+
+      if (!jump->wide)
+        bytes[length++] = displacement;
+      else
+        for (int k = 0; k < 4; k++)
+          bytes[length++] = displacement >> (8 * k);
+    }
+  memcpy (bytes + length, code->bytes + copied, code->length - copied);
+  length += code->length - copied;
+
+  for (size_t i = 0; i < code->labels_length; i++)
+    {
+      CodeLabel *label = &code->labels[i];
+      if (label->bound)
+        {
+          label->where.position += shift[label->where.jumps_before];
+          label->where.jumps_before = 0;
+        }
+    }
+  for (size_t i = 0; i < code->references_length; i++)
+    {
+      DataReference *reference = &code->references[i];
+      reference->where.position += shift[reference->where.jumps_before];
+      reference->where.jumps_before = 0;
+    }
+  for (size_t i = 0; i < code->label_references_length; i++)
+    {
+      const LabelReference *reference = &code->label_references[i];
+      const size_t where = reference->where.position + shift[reference->where.jumps_before];
+      const u32 displacement = label_offset (code, reference->target) - (where + 4);
+      for (int k = 0; k < 4; k++)
+        bytes[where + k] = displacement >> (8 * k);
+    }
+
+  free (shift);
+  free (code->bytes);
+  free (code->jumps);
+  code->bytes = bytes;
+  code->length = length;
+  code->alloc = length + 1;
+  code->jumps = NULL;
+  code->jumps_length = 0;
+  code->jumps_alloc = 0;
+}
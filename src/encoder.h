@@ -0,0 +1,287 @@
+/*  encoder.h
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#ifndef _ENCODER_H
+#define _ENCODER_H 1
+
+#include <stddef.h>
+
+#include "system.h"
+
+/* General purpose registers of x86-64 in the order of their encoding.  */
+typedef enum
+{
+  RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8,  R9,  R10, R11, R12, R13, R14, R15
+} Register;
+
+/* SSE registers.  */
+typedef enum
+{
+  XMM0, XMM1, XMM2,  XMM3,  XMM4,  XMM5,  XMM6,  XMM7,
+  XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15
+} XmmRegister;
+
+/* Operations of the immediate group (0x80, 0x81 and 0x83 opcodes),
+   the value is the /digit of ModRM.  */
+typedef enum
+{
+  ALU_ADD = 0,
+  ALU_OR  = 1,
+  ALU_AND = 4,
+  ALU_SUB = 5,
+  ALU_XOR = 6,
+  ALU_CMP = 7
+} AluOperation;
+
+/* Condition codes of the conditional jumps.  */
+typedef enum
+{
+  CC_B  = 0x2,
+  CC_AE = 0x3,
+  CC_E  = 0x4,
+  CC_NE = 0x5,
+  CC_BE = 0x6,
+  CC_A  = 0x7,
+  CC_L  = 0xc,
+  CC_GE = 0xd,
+  CC_LE = 0xe,
+  CC_G  = 0xf
+} Condition;
+
+/* Memory operand: either BASE + DISPLACEMENT or the byte
+   DISPLACEMENT of the data area, addressed relative to %rip.  */
+typedef struct
+{
+  Register base;
+  i32 displacement;
+  bool data;
+} Memory;
+
+#define MEMORY(base, displacement) ((Memory) { base, displacement, false })
+#define DATA(offset)               ((Memory) { RAX, offset, true })
+
+/* Index of a label in the code buffer.  */
+typedef size_t Label;
+
+/* Position in the code before relaxation: number of bytes emitted
+   and number of jumps emitted before it.  */
+typedef struct
+{
+  size_t position;
+  size_t jumps_before;
+} CodePosition;
+
+typedef struct
+{
+  CodePosition where;
+  bool bound;
+  /* Name of the symbol of the label in object files: NAME followed by
+     INDEX unless it is negative.  Unnamed labels have no symbol.  */
+  const char *name;
+  i32 index;
+  bool function;
+} CodeLabel;
+
+typedef struct
+{
+  CodePosition where;
+  Label target;
+  /* Condition code, or JUMP_ALWAYS or JUMP_CALL.  */
+  int kind;
+  bool wide;
+} CodeJump;
+
+/* 32-bit displacement from the end of the instruction to the byte
+   DATA_OFFSET of the data area.  */
+typedef struct
+{
+  CodePosition where;
+  u32 data_offset;
+  /* Size of the immediate which follows the displacement.  */
+  u8 immediate_size;
+} DataReference;
+
+/* 32-bit displacement from the end of the instruction to a label.  */
+typedef struct
+{
+  CodePosition where;
+  Label target;
+} LabelReference;
+
+/* Named part of the data area.  */
+typedef struct
+{
+  const char *name;
+  u32 offset;
+  u32 size;
+} DataSymbol;
+
+/* Machine code being encoded.  Jumps to labels are short where the
+   target is close enough and are resolved by finish_code (), after
+   which positions of labels and data references are final offsets in
+   BYTES.  */
+typedef struct
+{
+  u8 *bytes;
+  size_t length;
+  size_t alloc;
+
+  CodeLabel *labels;
+  size_t labels_length;
+  size_t labels_alloc;
+
+  CodeJump *jumps;
+  size_t jumps_length;
+  size_t jumps_alloc;
+
+  DataReference *references;
+  size_t references_length;
+  size_t references_alloc;
+
+  LabelReference *label_references;
+  size_t label_references_length;
+  size_t label_references_alloc;
+
+  DataSymbol *data_symbols;
+  size_t data_symbols_length;
+  size_t data_symbols_alloc;
+
+  /* Size of the data area the code refers to, and the initial contents
+     of its first DATA_LENGTH bytes, which are not copied.  The rest of
+     the area is zero.  */
+  size_t data_size;
+  const u8 *data;
+  size_t data_length;
+  /* Where execution starts.  */
+  Label entry;
+} CodeBuffer;
+
+extern void init_code (CodeBuffer *code)
+  __nonnull ((1));
+extern void free_code (CodeBuffer *code)
+  __nonnull ((1));
+
+/* Resolve all jumps, choosing the shortest encoding for each.  */
+extern void finish_code (CodeBuffer *code)
+  __nonnull ((1));
+
+/* Offset of the LABEL in the finished code.  */
+extern size_t label_offset (const CodeBuffer *code, Label label)
+  __nonnull ((1));
+
+extern Label new_label (CodeBuffer *code)
+  __nonnull ((1));
+extern void bind_label (CodeBuffer *code, Label label)
+  __nonnull ((1));
+/* Give LABEL a symbol, see CodeLabel.  NAME is not copied.  */
+extern void name_label (CodeBuffer *code, Label label,
+                        const char *name, i32 index, bool function)
+  __nonnull ((1, 3));
+/* Give SIZE bytes at OFFSET of the data area a symbol.  */
+extern void name_data (CodeBuffer *code, const char *name,
+                       u32 offset, u32 size)
+  __nonnull ((1, 2));
+
+extern void emit_bytes (CodeBuffer *code, const u8 *bytes, size_t n)
+  __nonnull ((1, 2));
+
+extern void x86_push (CodeBuffer *code, Register reg) __nonnull ((1));
+extern void x86_pop (CodeBuffer *code, Register reg) __nonnull ((1));
+extern void x86_ret (CodeBuffer *code) __nonnull ((1));
+extern void x86_syscall (CodeBuffer *code) __nonnull ((1));
+
+/* movl $IMMEDIATE,REG, zero-extended to the whole register.  */
+extern void x86_mov_imm32 (CodeBuffer *code, Register reg, u32 immediate)
+  __nonnull ((1));
+/* movq SRC,DST.  */
+extern void x86_mov_reg (CodeBuffer *code, Register dst, Register src)
+  __nonnull ((1));
+/* OPERATION of 64-bit registers: DST = DST op SRC.  */
+extern void x86_alu_reg (CodeBuffer *code, AluOperation operation,
+                         Register dst, Register src)
+  __nonnull ((1));
+/* OPERATION of 64-bit register and sign-extended 32-bit IMMEDIATE.  */
+extern void x86_alu_imm (CodeBuffer *code, AluOperation operation,
+                         Register reg, i32 immediate)
+  __nonnull ((1));
+/* OPERATION of byte in memory and 8-bit IMMEDIATE.  */
+extern void x86_alu_mem8_imm (CodeBuffer *code, AluOperation operation,
+                              Memory memory, u8 immediate)
+  __nonnull ((1));
+/* OPERATION of byte in memory and the low byte of REG.  */
+extern void x86_alu_mem8_reg (CodeBuffer *code, AluOperation operation,
+                              Memory memory, Register reg)
+  __nonnull ((1));
+/* imull $IMMEDIATE,SRC,DST of 32-bit registers.  */
+extern void x86_imul_imm (CodeBuffer *code, Register dst, Register src,
+                          i32 immediate)
+  __nonnull ((1));
+/* bsfq SRC,DST and bsrq SRC,DST.  */
+extern void x86_bsf (CodeBuffer *code, Register dst, Register src)
+  __nonnull ((1));
+extern void x86_bsr (CodeBuffer *code, Register dst, Register src)
+  __nonnull ((1));
+/* testq SRC,DST.  */
+extern void x86_test (CodeBuffer *code, Register dst, Register src)
+  __nonnull ((1));
+/* movq MEMORY,REG, movq REG,MEMORY and movq $IMMEDIATE,MEMORY.  */
+extern void x86_load64 (CodeBuffer *code, Register reg, Memory memory)
+  __nonnull ((1));
+extern void x86_store64 (CodeBuffer *code, Memory memory, Register reg)
+  __nonnull ((1));
+extern void x86_store64_imm (CodeBuffer *code, Memory memory, i32 immediate)
+  __nonnull ((1));
+/* movb MEMORY,REG, movb REG,MEMORY and movb $IMMEDIATE,MEMORY.  */
+extern void x86_load8 (CodeBuffer *code, Register reg, Memory memory)
+  __nonnull ((1));
+extern void x86_store8 (CodeBuffer *code, Memory memory, Register reg)
+  __nonnull ((1));
+extern void x86_store8_imm (CodeBuffer *code, Memory memory, u8 immediate)
+  __nonnull ((1));
+/* movzbl MEMORY,REG.  */
+extern void x86_load8_zero_extend (CodeBuffer *code, Register reg,
+                                   Memory memory)
+  __nonnull ((1));
+extern void x86_lea (CodeBuffer *code, Register reg, Memory memory)
+  __nonnull ((1));
+/* leaq LABEL(%rip),REG, for constants placed after the code.  */
+extern void x86_lea_label (CodeBuffer *code, Register reg, Label label)
+  __nonnull ((1));
+
+/* SSE2: pxor SRC,DST, pcmpeqb SRC,DST, movdqu MEMORY,DST and
+   pmovmskb SRC,DST.  */
+extern void x86_pxor (CodeBuffer *code, XmmRegister dst, XmmRegister src)
+  __nonnull ((1));
+extern void x86_pcmpeqb (CodeBuffer *code, XmmRegister dst, XmmRegister src)
+  __nonnull ((1));
+extern void x86_movdqu_load (CodeBuffer *code, XmmRegister dst, Memory memory)
+  __nonnull ((1));
+extern void x86_pmovmskb (CodeBuffer *code, Register dst, XmmRegister src)
+  __nonnull ((1));
+
+#define JUMP_ALWAYS (-1)
+#define JUMP_CALL   (-2)
+
+/* Jump to LABEL if CONDITION holds, or always for JUMP_ALWAYS.  */
+extern void x86_jump (CodeBuffer *code, int condition, Label label)
+  __nonnull ((1));
+extern void x86_call (CodeBuffer *code, Label label)
+  __nonnull ((1));
+
+#endif /* _ENCODER_H */
@@ -0,0 +1,198 @@
+/*  evaluator.c
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <config.h>
+
+#include "evaluator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "system.h"
+
+#include "compiler.h"
+#include "xalloc.h"
+
+void
+init_evaluation (Evaluation *state)
+{
+  memset (state, 0, sizeof (*state));
+  state->tape = xcalloc (DATA_ARRAY_SIZE, sizeof (*state->tape));
+}
+
+void
+free_evaluation (Evaluation *state)
+{
+  free (state->tape);
+  free (state->output);
+  memset (state, 0, sizeof (*state));
+}
+
+/* Cell at OFFSET from the pointer, or NULL if it is outside the array.  */
+static inline u8 *
+cell (const Evaluation *state, i64 offset)
+{
+  const i64 index = state->pointer + offset;
+  if (index < 0 || index >= DATA_ARRAY_SIZE)
+    return NULL;
+  return &state->tape[index];
+}
+
+/* Entry state of the current iteration of each loop, kept at the
+   position of its label.  A loop never ends when its body comes back
+   to the pointer where it started without having changed anything:
+   CHANGES counts the writes to the tape and the output.  */
+typedef struct
+{
+  i64 *pointer;
+  u64 *changes;
+} LoopEntries;
+
+static inline void
+enter_loop (LoopEntries *entries, size_t label,
+            const Evaluation *state, u64 changes)
+{
+  entries->pointer[label] = state->pointer;
+  entries->changes[label] = changes;
+}
+
+/* Run the command at the position and move to the next one.  */
+static EvaluationResult
+step (const Command *tokens, Evaluation *state,
+      LoopEntries *entries, u64 *changes)
+{
+  const Command current = tokens[state->position];
+  u8 *const current_cell = cell (state, 0);
+  u8 *target;
+
+  switch (current.token)
+    {
+    case T_INCDEC:
+      if ((target = cell (state, current.offset)) == NULL)
+        return EVALUATION_OUT_OF_TAPE;
+      *target += current.value;
+      ++*changes;
+      break;
+    case T_SET:
+      if ((target = cell (state, current.offset)) == NULL)
+        return EVALUATION_OUT_OF_TAPE;
+      *target = current.value;
+      ++*changes;
+      break;
+    case T_MULADD:
+      {
+        const u8 *const source_cell = cell (state, current.source_offset);
+        if ((target = cell (state, current.offset)) == NULL
+            || source_cell == NULL)
+          return EVALUATION_OUT_OF_TAPE;
+        *target += *source_cell * current.value;
+        ++*changes;
+      }
+      break;
+    case T_POINTER_INCDEC:
+      state->pointer += current.value;
+      break;
+    case T_SCAN:
+      if (current_cell == NULL)
+        return EVALUATION_OUT_OF_TAPE;
+      if (*current_cell != 0)
+        {
+          /* Stay at the scan until it finds a zero cell.  */
+          state->pointer += current.value;
+          return EVALUATION_RUNNING;
+        }
+      break;
+    case T_LABEL:
+      if (current_cell == NULL)
+        return EVALUATION_OUT_OF_TAPE;
+      if (*current_cell == 0)
+        {
+          state->position = current.match + 1;
+          return EVALUATION_RUNNING;
+        }
+      enter_loop (entries, state->position, state, *changes);
+      break;
+    case T_JUMP:
+      if (current_cell == NULL)
+        return EVALUATION_OUT_OF_TAPE;
+      if (*current_cell != 0)
+        {
+          if (entries->pointer[current.match] == state->pointer
+              && entries->changes[current.match] == *changes)
+            return EVALUATION_INFINITE_LOOP;
+          enter_loop (entries, current.match, state, *changes);
+          state->position = current.match + 1;
+          return EVALUATION_RUNNING;
+        }
+      break;
+    case T_GETCHAR:
+      return EVALUATION_INPUT;
+    case T_PUTCHAR:
+      if (current_cell == NULL)
+        return EVALUATION_OUT_OF_TAPE;
+      if (state->output_length == state->output_alloc)
+        state->output = x2nrealloc (state->output, &state->output_alloc,
+                                    sizeof (*state->output));
+      state->output[state->output_length++] = *current_cell;
+      ++*changes;
+      break;
+    case T_COMMENT:
+    default:
+      break;
+    }
+
+  state->position++;
+  return EVALUATION_RUNNING;
+}
+
+EvaluationResult
+evaluate (const ProgramSource *const source,
+          Evaluation *state,
+          u64 step_limit)
+{
+  EvaluationResult result = EVALUATION_STEP_LIMIT_REACHED;
+  LoopEntries entries;
+  entries.pointer = xnmalloc (source->length, sizeof (*entries.pointer));
+  entries.changes = xnmalloc (source->length, sizeof (*entries.changes));
+  u64 changes = 0;
+
+  for (u64 steps = 0; steps < step_limit; steps++)
+    {
+      if (state->position == source->length)
+        {
+          result = EVALUATION_FINISHED;
+          break;
+        }
+
+      const EvaluationResult step_result = step (source->tokens, state,
+                                                 &entries, &changes);
+      if (step_result != EVALUATION_RUNNING)
+        {
+          result = step_result;
+          break;
+        }
+    }
+
+  if (result == EVALUATION_STEP_LIMIT_REACHED
+      && state->position == source->length)
+    result = EVALUATION_FINISHED;
+
+  free (entries.pointer);
+  free (entries.changes);
+
+  return result;
+}
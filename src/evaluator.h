@@ -0,0 +1,73 @@
+/*  evaluator.h
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _EVALUATOR_H
+#define _EVALUATOR_H 1
+
+#include <stddef.h>
+
+#include "tokenizer.h"
+
+#include "system.h"
+
+/* Number of steps a program is run for at compile time before giving
+   up on evaluating it.  */
+#define EVALUATION_STEP_LIMIT (UINT64_C (1) << 26)
+
+typedef enum
+{
+  /* The program has not stopped yet.  */
+  EVALUATION_RUNNING,
+  /* The program ended.  */
+  EVALUATION_FINISHED,
+  /* The next command reads input.  */
+  EVALUATION_INPUT,
+  /* The program is in a loop which never ends.  */
+  EVALUATION_INFINITE_LOOP,
+  /* The step limit was reached.  */
+  EVALUATION_STEP_LIMIT_REACHED,
+  /* The pointer left the data array.  */
+  EVALUATION_OUT_OF_TAPE
+} EvaluationResult;
+
+/* State of a program being run at compile time.  */
+typedef struct
+{
+  /* DATA_ARRAY_SIZE cells.  */
+  u8 *tape;
+  i64 pointer;
+  /* Index of the next command.  */
+  size_t position;
+  /* Everything the program has printed.  */
+  char *output;
+  size_t output_length;
+  size_t output_alloc;
+} Evaluation;
+
+extern void init_evaluation (Evaluation *state)
+  __nonnull ((1));
+extern void free_evaluation (Evaluation *state)
+  __nonnull ((1));
+
+/* Run SOURCE from STATE for at most STEP_LIMIT commands.  The position
+   stays at the command which stopped the run, if any.  */
+extern EvaluationResult evaluate (const ProgramSource *const source,
+                                  Evaluation *state,
+                                  u64 step_limit)
+  __nonnull ((1, 2));
+
+#endif /* _EVALUATOR_H */
@@ -15,52 +15,170 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
-static const char init_variables[] =
+const char target_name[] = "i386";
+
+/* The array starts with the cells known at compile time, if any.  */
+static const char init_array[] =
 ".section .data\n"
-"array:\n"
+"array:\n";
+static const char init_variables[] =
 "        .zero       %u\n"
-"buffer:\n"
-"        .byte       0\n";
+"        .balign     4\n"
+"output_length:\n"
+"        .long       0\n"
+"input_position:\n"
+"        .long       0\n"
+"input_length:\n"
+"        .long       0\n"
+"interactive:\n"
+"        .long       0\n"
+"termios:\n"
+"        .zero       64\n"
+"input:\n"
+"        .zero       %u\n"
+"output:\n"
+"        .zero       %u\n";
+
+static const char data_bytes[] =
+"        .byte       %s\n";
+
+/* Output known at compile time, see write_constant_output.  */
+static const char constant_output_begin[] =
+".section .rodata\n"
+"constant_output:\n";
 
 static const char init_section_text[] =
 ".section .text\n"
 ".globl _start\n"
 "\n";
 
+/* Output is collected in the buffer OUTPUT and written when it is full,
+   before reading input and at exit.  */
+static const char flush_body[] =
+".type flush,@function\n"
+"flush:\n"
+"        pushl       %%eax\n"
+"        movl        $output,%%ecx\n"
+"        movl        output_length,%%edx\n"
+".Lflush_write:\n"
+"        testl       %%edx,%%edx\n"
+"        je          .Lflush_done\n"
+"        movl        $4,%%eax\n"
+"        movl        $1,%%ebx\n"
+"        int         $0x80\n"
+"        testl       %%eax,%%eax\n"
+"        jle         .Lflush_done\n"
+"        addl        %%eax,%%ecx\n"
+"        subl        %%eax,%%edx\n"
+"        jmp         .Lflush_write\n"
+".Lflush_done:\n"
+"        movl        $0,output_length\n"
+"        popl        %%eax\n"
+"        ret\n"
+"\n";
+
+/* Input is read in blocks into the buffer INPUT, which is refilled
+   when it is empty.  At the end of input the cell is set according to
+   the EOF policy.  */
 static const char getchar_body[] =
 ".type getchar,@function\n"
 "getchar:\n"
+"        call        flush\n"
+"        movl        input_position,%%ecx\n"
+"        cmpl        input_length,%%ecx\n"
+"        jb          .Lgetchar_read\n"
 "        pushl       %%eax\n"
 "        movl        $3,%%eax\n"
-"        movl        $0,%%ebx\n"
-"        movl        $buffer,%%ecx\n"
-"        movl        $1,%%edx\n"
+"        xorl        %%ebx,%%ebx\n"
+"        movl        $input,%%ecx\n"
+"        movl        $%u,%%edx\n"
 "        int         $0x80\n"
+"        movl        %%eax,%%edx\n"
 "        popl        %%eax\n"
-"        movb        (buffer),%%cl\n"
-"        movb        %%cl,(%%eax)\n"
+"        testl       %%edx,%%edx\n"
+"        jle         .Lgetchar_eof\n"
+"        movl        %%edx,input_length\n"
+"        xorl        %%ecx,%%ecx\n"
+".Lgetchar_read:\n"
+"        movb        input(%%ecx),%%bl\n"
+"        movb        %%bl,(%%eax)\n"
+"        addl        $1,%%ecx\n"
+"        movl        %%ecx,input_position\n"
+"        ret\n"
+".Lgetchar_eof:\n";
+
+static const char eof_zero[] =
+"        movb        $0,(%%eax)\n";
+static const char eof_minus_one[] =
+"        movb        $255,(%%eax)\n";
+
+static const char getchar_fini[] =
 "        ret\n"
 "\n";
 
 static const char putchar_body[] =
-".type getchar,@function\n"
+".type putchar,@function\n"
 "putchar:\n"
-"        pushl       %%eax\n"
+"        movl        output_length,%%ecx\n"
 "        movb        (%%eax),%%bl\n"
-"        movb        %%bl,(buffer)\n"
-"        movl        $4,%%eax\n"
-"        movl        $1,%%ebx\n"
-"        movl        $buffer,%%ecx\n"
-"        movl        $1,%%edx\n"
-"        int         $0x80\n"
-"        popl        %%eax\n"
+"        movb        %%bl,output(%%ecx)\n"
+"        addl        $1,%%ecx\n"
+"        movl        %%ecx,output_length\n"
+"        cmpl        $%u,%%ecx\n"
+"        je          flush\n"
+"        cmpb        $10,%%bl\n"
+"        jne         .Lputchar_done\n"
+"        cmpb        $0,interactive\n"
+"        jne         flush\n"
+".Lputchar_done:\n"
 "        ret\n"
 "\n";
 
 static const char start_init[] =
 ".type _start,@function\n"
-"_start:\n"
-"        movl        $array,%%eax\n";
+"_start:\n";
+
+/* Output to a terminal is flushed at every newline, so the program
+   talks to the user a line at a time.  */
+static const char detect_terminal[] =
+"        movl        $54,%%eax\n"
+"        movl        $1,%%ebx\n"
+"        movl        $0x5401,%%ecx\n"
+"        movl        $termios,%%edx\n"
+"        int         $0x80\n"
+"        testl       %%eax,%%eax\n"
+"        jne         .Lnot_terminal\n"
+"        movb        $1,interactive\n"
+".Lnot_terminal:\n";
+
+/* Output known at compile time is written at once before the program
+   starts.  */
+static const char write_constant_output[] =
+"        movl        $constant_output,%%ecx\n"
+"        movl        $%zu,%%edx\n"
+".Lconstant_output_write:\n"
+"        movl        $4,%%eax\n"
+"        movl        $1,%%ebx\n"
+"        int         $0x80\n"
+"        testl       %%eax,%%eax\n"
+"        jle         .Lconstant_output_done\n"
+"        addl        %%eax,%%ecx\n"
+"        subl        %%eax,%%edx\n"
+"        jne         .Lconstant_output_write\n"
+".Lconstant_output_done:\n";
+
+static const char init_pointer[] =
+"        movl        $array+%zu,%%eax\n";
+
+/* Program which was run up to some command at compile time continues
+   from there.  */
+static const char jump_to_start[] =
+"        jmp         .Lresume\n";
+static const char start_label[] =
+".Lresume:\n";
+
+static const char call_flush[] =
+"        call        flush\n";
 
 static const char start_fini[] =
 "\n"
@@ -68,16 +186,38 @@ static const char start_fini[] =
 "        xorl        %%ebx,%%ebx\n"
 "        int         $0x80\n";
 static const char increment_current_value[] =
-"        movb        $%i,%%bl\n"
-"        addb        %%bl,(%%eax)\n";
+"        addb        $%i,%i(%%eax)\n";
 static const char decrement_current_value[] =
-"        movb        $%i,%%bl\n"
-"        subb        %%bl,(%%eax)\n";
+"        subb        $%i,%i(%%eax)\n";
+static const char set_current_value[] =
+"        movb        $%i,%i(%%eax)\n";
+/* The cell at the source offset multiplied by a factor is added to
+   the cell at the offset.  */
+static const char load_source_value[] =
+"        movzbl      %i(%%eax),%%ecx\n";
+static const char multiply_source_value[] =
+"        imull       $%i,%%ecx,%%ecx\n";
+static const char add_product[] =
+"        addb        %%cl,%i(%%eax)\n";
+static const char subtract_product[] =
+"        subb        %%cl,%i(%%eax)\n";
 static const char increment_current_pointer[] =
 "        addl        $%i,%%eax\n";
 static const char decrement_current_pointer[] =
 "        subl        $%i,%%eax\n";
 
+/* The baseline of the architecture has no SSE2, scans for a zero cell
+   look at a cell at a time.  */
+#define HAVE_VECTOR_SCAN 0
+
+static const char scan_scalar[] =
+".LSS%zu:\n"
+"        cmpb        $0,(%%eax)\n"
+"        je          .LSD%zu\n"
+"        addl        $%i,%%eax\n"
+"        jmp         .LSS%zu\n"
+".LSD%zu:\n";
+
 static const char label_begin[] =
 "\n"
 ".LB%i:\n"
@@ -89,17 +229,59 @@ static const char label_end[] =
 "        cmpb        $0,(%%eax)\n"
 "        jne         .LB%i\n";
 
+/* Profiled programs count how many times every loop is reached and
+   how many times its body runs in the counters section, and write the
+   section to the profile file at exit.  */
+static const char profile_begin[] =
+".section .bfc_counters,\"aw\",@progbits\n"
+"        .balign     8\n"
+"profile:\n"
+"        .ascii      \"%s\"\n"
+"        .quad       %zu\n"
+"profile_counters:\n";
+static const char profile_loop[] =
+"        .quad       %i,0,0\n";
+static const char profile_end[] =
+"profile_end:\n"
+"profile_filename:\n";
+/* The counters have 64 bits.  */
+static const char count_profile_event[] =
+"        movl        $profile_counters+%zu,%%ecx\n"
+"        addl        $1,(%%ecx)\n"
+"        adcl        $0,4(%%ecx)\n";
+static const char dump_profile[] =
+"        movl        $5,%%eax\n"
+"        movl        $profile_filename,%%ebx\n"
+"        movl        $0x241,%%ecx\n"
+"        movl        $0644,%%edx\n"
+"        int         $0x80\n"
+"        testl       %%eax,%%eax\n"
+"        js          .Lprofile_done\n"
+"        movl        %%eax,%%ebx\n"
+"        movl        $4,%%eax\n"
+"        movl        $profile,%%ecx\n"
+"        movl        $profile_end-profile,%%edx\n"
+"        int         $0x80\n"
+"        movl        $6,%%eax\n"
+"        int         $0x80\n"
+".Lprofile_done:\n";
+
 static const char call_getchar[] =
 "        call        getchar\n";
 static const char call_putchar[] =
 "        call        putchar\n";
 
+/* There is no machine code encoder for this architecture.  */
+#define HAVE_ENCODER 0
+
 int
-compile_to_obj (char *asm_filename, char *obj_filename)
+compile_to_obj (char *asm_filename, char *obj_filename,
+                const ProgramSource *source)
 {
-  char *as[] = { "as", "-O2", "--32", "-o", obj_filename, asm_filename, (char *) NULL };
+  char *as[] = { "as", "-O2", "--32", "-o", obj_filename,
+                 asm_filename != NULL ? asm_filename : "--", (char *) NULL };
 
-  int err = exec (as);
+  int err = exec (as, asm_filename != NULL ? NULL : source);
   if (err != 0)
     error (0, 0, _("error: as returned %i exit status"), err);
 
@@ -119,7 +301,7 @@ link_to_elf (char *obj_filename, char *elf_filename, bool with_debug_info)
       ld[countof (ld) - 1] = "--strip-all";
     }
 
-  int err = exec (ld);
+  int err = exec (ld, NULL);
   if (err != 0)
     error (0, 0, _("error: ld returned %i exit status"), err);
 
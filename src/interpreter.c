@@ -0,0 +1,621 @@
+/*  interpreter.c
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <config.h>
+
+#include "interpreter.h"
+
+#include <error.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "system.h"
+
+#include "arch.h"
+#include "compiler.h"
+#include "jit.h"
+#include "xalloc.h"
+
+/* Number of iterations after which a loop is compiled to machine code
+   in tiered execution.  */
+#define TIER_THRESHOLD 10000
+
+typedef enum
+{
+  OP_INCDEC,
+  OP_SET,
+  OP_MULADD,
+  OP_POINTER_INCDEC,
+  OP_SCAN,
+  OP_LABEL,
+  OP_JUMP,
+  OP_GETCHAR,
+  OP_PUTCHAR,
+  /* Superinstructions: an increment followed by a pointer move, and
+     a pointer move followed by the end of a loop.  */
+  OP_INCDEC_POINTER_INCDEC,
+  OP_POINTER_INCDEC_JUMP,
+  OP_EXIT,
+  OP_MAX
+} Operation;
+
+/* One instruction of the bytecode.  HANDLER is the address of the code
+   which runs it, so that every handler jumps straight to the next one.
+   TARGET is the index of the instruction a loop continues with.  */
+typedef struct
+{
+  const void *handler;
+  i32 value;
+  i32 offset;
+  i32 source_offset;
+  i32 move;
+  size_t target;
+} Instruction;
+
+/* Loop of tiered execution.  NATIVE is set by the compiler thread once
+   the loop is compiled, to the machine code which runs the rest of the
+   loop from its head and returns the pointer.  */
+typedef struct
+{
+  size_t command;
+  u64 iterations;
+  u8 *(*native) (u8 *);
+  void *map;
+  size_t map_size;
+} Loop;
+
+typedef struct
+{
+  Instruction *code;
+  size_t length;
+  size_t allocated;
+  /* Instruction of each command.  */
+  size_t *positions;
+  /* Largest distance from the pointer of a cell accessed.  */
+  i32 reach;
+  /* Loops, the value of their labels is the index here.  */
+  Loop *loops;
+  size_t loops_length;
+  size_t loops_allocated;
+} Bytecode;
+
+static Instruction *
+append_instruction (Bytecode *bytecode, Operation operation)
+{
+  if (bytecode->length == bytecode->allocated)
+    bytecode->code = x2nrealloc (bytecode->code, &bytecode->allocated,
+                                 sizeof (*bytecode->code));
+
+  Instruction *instruction = &bytecode->code[bytecode->length++];
+  memset (instruction, 0, sizeof (*instruction));
+  instruction->handler = (const void *) (uintptr_t) operation;
+  return instruction;
+}
+
+static void
+reach (Bytecode *bytecode, i32 offset)
+{
+  if (offset < 0)
+    offset = -offset;
+  if (bytecode->reach < offset)
+    bytecode->reach = offset;
+}
+
+/* Translates SOURCE to BYTECODE.  Handlers are left as operations.  */
+static void
+translate (const ProgramSource *const source, Bytecode *bytecode)
+{
+  memset (bytecode, 0, sizeof (*bytecode));
+  bytecode->positions = xnmalloc (source->length + 1,
+                                  sizeof (*bytecode->positions));
+
+  for (size_t i = 0; i < source->length; i++)
+    {
+      const Command current = source->tokens[i];
+      const Command *next = i + 1 < source->length && i + 1 != source->start
+                            ? &source->tokens[i + 1] : NULL;
+      Instruction *instruction;
+      bytecode->positions[i] = bytecode->length;
+
+      switch (current.token)
+        {
+        case T_INCDEC:
+          reach (bytecode, current.offset);
+          if (next != NULL && next->token == T_POINTER_INCDEC)
+            {
+              instruction = append_instruction (bytecode, OP_INCDEC_POINTER_INCDEC);
+              instruction->move = next->value;
+              bytecode->positions[++i] = bytecode->length - 1;
+            }
+          else
+            instruction = append_instruction (bytecode, OP_INCDEC);
+          instruction->value = current.value;
+          instruction->offset = current.offset;
+          break;
+        case T_SET:
+          reach (bytecode, current.offset);
+          instruction = append_instruction (bytecode, OP_SET);
+          instruction->value = current.value;
+          instruction->offset = current.offset;
+          break;
+        case T_MULADD:
+          reach (bytecode, current.offset);
+          reach (bytecode, current.source_offset);
+          instruction = append_instruction (bytecode, OP_MULADD);
+          instruction->value = current.value;
+          instruction->offset = current.offset;
+          instruction->source_offset = current.source_offset;
+          break;
+        case T_POINTER_INCDEC:
+          if (next != NULL && next->token == T_JUMP)
+            {
+              instruction = append_instruction (bytecode, OP_POINTER_INCDEC_JUMP);
+              instruction->target = next->match;
+              bytecode->positions[++i] = bytecode->length - 1;
+            }
+          else
+            instruction = append_instruction (bytecode, OP_POINTER_INCDEC);
+          instruction->move = current.value;
+          break;
+        case T_SCAN:
+          instruction = append_instruction (bytecode, OP_SCAN);
+          instruction->move = current.value;
+          break;
+        case T_LABEL:
+          instruction = append_instruction (bytecode, OP_LABEL);
+          instruction->target = current.match;
+          if (bytecode->loops_length == bytecode->loops_allocated)
+            bytecode->loops = x2nrealloc (bytecode->loops,
+                                          &bytecode->loops_allocated,
+                                          sizeof (*bytecode->loops));
+          memset (&bytecode->loops[bytecode->loops_length], 0,
+                  sizeof (*bytecode->loops));
+          bytecode->loops[bytecode->loops_length].command = i;
+          instruction->value = bytecode->loops_length++;
+          break;
+        case T_JUMP:
+          instruction = append_instruction (bytecode, OP_JUMP);
+          instruction->target = current.match;
+          break;
+        case T_GETCHAR:
+          append_instruction (bytecode, OP_GETCHAR);
+          break;
+        case T_PUTCHAR:
+          append_instruction (bytecode, OP_PUTCHAR);
+          break;
+        case T_COMMENT:
+        default:
+          break;
+        }
+    }
+
+  bytecode->positions[source->length] = bytecode->length;
+  append_instruction (bytecode, OP_EXIT);
+
+  /* Loops continue after the instruction of their matching command.  */
+  for (size_t i = 0; i < bytecode->length; i++)
+    {
+      const Operation operation = (uintptr_t) bytecode->code[i].handler;
+      if (operation == OP_LABEL || operation == OP_JUMP
+          || operation == OP_POINTER_INCDEC_JUMP)
+        bytecode->code[i].target = bytecode->positions[bytecode->code[i].target] + 1;
+    }
+}
+
+/* Buffered input and output with the same behaviour as the runtime of
+   compiled programs.  */
+typedef struct
+{
+  u8 *input;
+  size_t input_position;
+  size_t input_length;
+  u8 *output;
+  size_t output_length;
+  bool interactive;
+} Streams;
+
+static void
+flush (Streams *streams)
+{
+  const u8 *begin = streams->output;
+  size_t remaining = streams->output_length;
+
+  while (remaining != 0)
+    {
+      ssize_t res = write (STDOUT_FILENO, begin, remaining);
+      if (res <= 0)
+        break;
+      begin += res;
+      remaining -= res;
+    }
+
+  streams->output_length = 0;
+}
+
+static inline void
+put (Streams *streams, u8 c)
+{
+  streams->output[streams->output_length++] = c;
+  if (streams->output_length == output_buffer_size
+      || (c == '\n' && streams->interactive))
+    flush (streams);
+}
+
+static inline void
+get (Streams *streams, u8 *cell)
+{
+  flush (streams);
+  if (streams->input_position == streams->input_length)
+    {
+      ssize_t res = read (STDIN_FILENO, streams->input, INPUT_BUFFER_SIZE);
+      if (res <= 0)
+        {
+          if (eof_policy == EOF_ZERO)
+            *cell = 0;
+          else if (eof_policy == EOF_MINUS_ONE)
+            *cell = 255;
+          return;
+        }
+      streams->input_position = 0;
+      streams->input_length = res;
+    }
+  *cell = streams->input[streams->input_position++];
+}
+
+/* Background compiler of hot loops.  The interpreter queues loops
+   and goes on interpreting them until their machine code is ready.  */
+typedef struct
+{
+  const ProgramSource *source;
+  Bytecode *bytecode;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+  size_t *queue;
+  size_t queue_length;
+  size_t queue_allocated;
+  bool stop;
+} Compiler;
+
+/* Returns true if the loop of SOURCE which begins at the label FIRST,
+   and every loop inside it, ends each iteration on the cell it began
+   on, and touches no cell further than MARGIN from there.  Machine
+   code of loops has no bounds checks, so only these loops are
+   compiled: begun inside the array, they stay inside the tape.  */
+static bool
+loop_stays_in_margin (const ProgramSource *source, size_t first,
+                      i32 margin)
+{
+  const size_t last = source->tokens[first].match;
+  /* Distance from the first cell of the pointer at every label.  */
+  i64 *labels = xnmalloc (last - first + 1, sizeof (*labels));
+  i64 position = 0;
+  bool stays = true;
+
+  for (size_t i = first; i <= last && stays; i++)
+    {
+      const Command current = source->tokens[i];
+      switch (current.token)
+        {
+        case T_INCDEC:
+        case T_SET:
+          stays = llabs (position + current.offset) <= margin;
+          break;
+        case T_MULADD:
+          stays = llabs (position + current.offset) <= margin
+                  && llabs (position + current.source_offset) <= margin;
+          break;
+        case T_POINTER_INCDEC:
+          position += current.value;
+          stays = llabs (position) <= margin;
+          break;
+        case T_SCAN:
+          stays = false;
+          break;
+        case T_LABEL:
+          labels[i - first] = position;
+          break;
+        case T_JUMP:
+          stays = labels[current.match - first] == position;
+          break;
+        default:
+          break;
+        }
+    }
+
+  free (labels);
+
+  return stays;
+}
+
+static void *
+compile_loops (void *argument)
+{
+  Compiler *compiler = argument;
+
+  pthread_mutex_lock (&compiler->mutex);
+  while (!compiler->stop)
+    {
+      if (compiler->queue_length == 0)
+        {
+          pthread_cond_wait (&compiler->wake, &compiler->mutex);
+          continue;
+        }
+
+      Loop *loop = &compiler->bytecode->loops[compiler->queue[--compiler->queue_length]];
+      pthread_mutex_unlock (&compiler->mutex);
+
+      CodeBuffer code;
+      init_code (&code);
+      if (loop_stays_in_margin (compiler->source, loop->command,
+                                compiler->bytecode->reach)
+          && loop_to_code (compiler->source, loop->command, &code))
+        {
+          void *native = map_function (&code, &loop->map, &loop->map_size);
+          __atomic_store_n (&loop->native, native, __ATOMIC_RELEASE);
+        }
+      free_code (&code);
+
+      pthread_mutex_lock (&compiler->mutex);
+    }
+  pthread_mutex_unlock (&compiler->mutex);
+
+  return NULL;
+}
+
+static void
+request_compilation (Compiler *compiler, const Loop *loop)
+{
+  pthread_mutex_lock (&compiler->mutex);
+  if (compiler->queue_length == compiler->queue_allocated)
+    compiler->queue = x2nrealloc (compiler->queue, &compiler->queue_allocated,
+                                  sizeof (*compiler->queue));
+  compiler->queue[compiler->queue_length++] = loop - compiler->bytecode->loops;
+  pthread_cond_signal (&compiler->wake);
+  pthread_mutex_unlock (&compiler->mutex);
+}
+
+/* Runs BYTECODE on the cells from TAPE to TAPE_END, starting at START
+   with the pointer at POINTER.  Returns false if the pointer leaves the
+   array.  Every handler ends by jumping to the handler of the next
+   instruction, which keeps a separate branch for each of them.  With a
+   COMPILER, loops count their iterations, and a loop whose machine code
+   is ready runs it from its head.  */
+static bool
+run (Bytecode *bytecode, size_t start, u8 *pointer,
+     u8 *const tape, u8 *const tape_end, Streams *streams,
+     Compiler *compiler)
+{
+  const void *handlers[OP_MAX] =
+  {
+    [OP_INCDEC] = &&do_incdec,
+    [OP_SET] = &&do_set,
+    [OP_MULADD] = &&do_muladd,
+    [OP_POINTER_INCDEC] = &&do_pointer_incdec,
+    [OP_SCAN] = &&do_scan,
+    [OP_LABEL] = &&do_label,
+    [OP_JUMP] = &&do_jump,
+    [OP_GETCHAR] = &&do_getchar,
+    [OP_PUTCHAR] = &&do_putchar,
+    [OP_INCDEC_POINTER_INCDEC] = &&do_incdec_pointer_incdec,
+    [OP_POINTER_INCDEC_JUMP] = &&do_pointer_incdec_jump,
+    [OP_EXIT] = &&do_exit
+  };
+  if (compiler != NULL)
+    {
+      handlers[OP_LABEL] = &&do_tiered_label;
+      handlers[OP_JUMP] = &&do_tiered_jump;
+      handlers[OP_POINTER_INCDEC_JUMP] = &&do_tiered_pointer_incdec_jump;
+    }
+
+  Instruction *const code = bytecode->code;
+  for (size_t i = 0; i < bytecode->length; i++)
+    code[i].handler = handlers[(uintptr_t) code[i].handler];
+
+  const Instruction *ip = &code[start];
+  Loop *loop;
+  u8 *(*native) (u8 *);
+
+#define DISPATCH() goto *ip->handler
+#define NEXT() do { ip++; DISPATCH (); } while (0)
+#define MOVE(amount)                                    \
+  do                                                    \
+    {                                                   \
+      pointer += (amount);                              \
+      if (pointer < tape || pointer >= tape_end)        \
+        return false;                                   \
+    }                                                   \
+  while (0)
+#define NATIVE(loop)                                                    \
+  __atomic_load_n (&(loop)->native, __ATOMIC_ACQUIRE)
+#define RUN_NATIVE()                                                    \
+  do                                                                    \
+    {                                                                   \
+      pointer = native (pointer);                                       \
+      if (pointer < tape || pointer >= tape_end)                        \
+        return false;                                                   \
+    }                                                                   \
+  while (0)
+/* The end of a loop which continues: interpreted until the loop has
+   machine code, which then runs the remaining iterations.  */
+#define TIERED_JUMP()                                                   \
+  do                                                                    \
+    {                                                                   \
+      loop = &bytecode->loops[code[ip->target - 1].value];              \
+      if (++loop->iterations == TIER_THRESHOLD)                         \
+        request_compilation (compiler, loop);                           \
+      if ((native = NATIVE (loop)) != NULL)                             \
+        {                                                               \
+          RUN_NATIVE ();                                                \
+          NEXT ();                                                      \
+        }                                                               \
+      ip = &code[ip->target];                                           \
+      DISPATCH ();                                                      \
+    }                                                                   \
+  while (0)
+
+  DISPATCH ();
+
+do_incdec:
+  pointer[ip->offset] += ip->value;
+  NEXT ();
+do_set:
+  pointer[ip->offset] = ip->value;
+  NEXT ();
+do_muladd:
+  pointer[ip->offset] += pointer[ip->source_offset] * ip->value;
+  NEXT ();
+do_pointer_incdec:
+  MOVE (ip->move);
+  NEXT ();
+do_scan:
+  while (*pointer != 0)
+    MOVE (ip->move);
+  NEXT ();
+do_label:
+  if (*pointer == 0)
+    {
+      ip = &code[ip->target];
+      DISPATCH ();
+    }
+  NEXT ();
+do_jump:
+  if (*pointer != 0)
+    {
+      ip = &code[ip->target];
+      DISPATCH ();
+    }
+  NEXT ();
+do_getchar:
+  get (streams, pointer);
+  NEXT ();
+do_putchar:
+  put (streams, *pointer);
+  NEXT ();
+do_incdec_pointer_incdec:
+  pointer[ip->offset] += ip->value;
+  MOVE (ip->move);
+  NEXT ();
+do_pointer_incdec_jump:
+  MOVE (ip->move);
+  if (*pointer != 0)
+    {
+      ip = &code[ip->target];
+      DISPATCH ();
+    }
+  NEXT ();
+do_tiered_label:
+  if ((native = NATIVE (&bytecode->loops[ip->value])) != NULL)
+    {
+      RUN_NATIVE ();
+      ip = &code[ip->target];
+      DISPATCH ();
+    }
+  goto do_label;
+do_tiered_jump:
+  if (*pointer != 0)
+    TIERED_JUMP ();
+  NEXT ();
+do_tiered_pointer_incdec_jump:
+  MOVE (ip->move);
+  if (*pointer != 0)
+    TIERED_JUMP ();
+  NEXT ();
+do_exit:
+  return true;
+
+#undef TIERED_JUMP
+#undef RUN_NATIVE
+#undef NATIVE
+#undef MOVE
+#undef NEXT
+#undef DISPATCH
+}
+
+int
+interpret_program (const ProgramSource *const source, bool tiered)
+{
+  Bytecode bytecode;
+  translate (source, &bytecode);
+
+  Compiler compiler;
+  if (tiered)
+    {
+      memset (&compiler, 0, sizeof (compiler));
+      compiler.source = source;
+      compiler.bytecode = &bytecode;
+      pthread_mutex_init (&compiler.mutex, NULL);
+      pthread_cond_init (&compiler.wake, NULL);
+      int err = pthread_create (&compiler.thread, NULL, compile_loops, &compiler);
+      if (err != 0)
+        {
+          error (0, err, _("warning: cannot start the compiler thread"));
+          tiered = false;
+        }
+    }
+
+  /* Cells accessed at an offset from the pointer stay inside the
+     allocation even when the pointer is at an end of the array.  */
+  const size_t margin = bytecode.reach;
+  u8 *const cells = xcalloc (DATA_ARRAY_SIZE + 2 * margin, sizeof (*cells));
+  u8 *const tape = cells + margin;
+  memcpy (tape, source->tape, source->tape_length);
+
+  Streams streams;
+  memset (&streams, 0, sizeof (streams));
+  streams.input = xmalloc (INPUT_BUFFER_SIZE);
+  streams.output = xmalloc (output_buffer_size);
+  streams.interactive = source->have_putchar_commands && isatty (STDOUT_FILENO);
+
+  for (size_t i = 0; i < source->output_length; i++)
+    put (&streams, source->output[i]);
+
+  bool finished = run (&bytecode, bytecode.positions[source->start],
+                       tape + source->start_pointer,
+                       tape, tape + DATA_ARRAY_SIZE, &streams,
+                       tiered ? &compiler : NULL);
+  flush (&streams);
+
+  if (tiered)
+    {
+      pthread_mutex_lock (&compiler.mutex);
+      compiler.stop = true;
+      pthread_cond_signal (&compiler.wake);
+      pthread_mutex_unlock (&compiler.mutex);
+      pthread_join (compiler.thread, NULL);
+
+      for (size_t i = 0; i < bytecode.loops_length; i++)
+        if (bytecode.loops[i].map != NULL)
+          munmap (bytecode.loops[i].map, bytecode.loops[i].map_size);
+      free (compiler.queue);
+    }
+
+  if (!finished)
+    error (0, 0, _("error: the pointer moved out of the array"));
+
+  free (streams.output);
+  free (streams.input);
+  free (cells);
+  free (bytecode.loops);
+  free (bytecode.positions);
+  free (bytecode.code);
+
+  return finished ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,31 @@
+/*  interpreter.h
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _INTERPRETER_H
+#define _INTERPRETER_H 1
+
+#include "tokenizer.h"
+
+#include "system.h"
+
+/* Translates tokenized source to bytecode and interprets it.  If
+   TIERED, loops which run long are compiled to machine code in the
+   background and switched to once it is ready.  */
+extern int interpret_program (const ProgramSource *const source, bool tiered)
+  __nonnull ((1));
+
+#endif /* _INTERPRETER_H */
@@ -0,0 +1,115 @@
+/*  jit.c
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include <config.h>
+
+#include "jit.h"
+
+#include <error.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "system.h"
+
+#include "arch.h"
+#include "encoder.h"
+
+/* The program is mapped as a single block: machine code first, then
+   its data area on the following pages.  The code addresses data
+   relative to %rip, so it runs wherever it is mapped.  */
+int
+run_program (const ProgramSource *const source)
+{
+  CodeBuffer code;
+  init_code (&code);
+  if (!tokens_to_code (source, &code, true))
+    {
+      error (0, 0, _("running programs in memory is not supported on this architecture"));
+      free_code (&code);
+      return EXIT_FAILURE;
+    }
+
+  const size_t page_size = sysconf (_SC_PAGESIZE);
+  const size_t code_size = (code.length + page_size - 1) / page_size * page_size;
+  const size_t data_size = (code.data_size + page_size - 1) / page_size * page_size;
+
+  /* Anonymous mapping is zeroed, so only the start of the data area
+     needs initialization.  */
+  u8 *map = mmap (NULL, code_size + data_size, PROT_READ|PROT_WRITE,
+                  MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED)
+    {
+      error (0, errno, _("failed to map memory for the program"));
+      free_code (&code);
+      return EXIT_FAILURE;
+    }
+
+  memcpy (map, code.bytes, code.length);
+  if (code.data_length != 0)
+    memcpy (map + code_size, code.data, code.data_length);
+  for (size_t i = 0; i < code.references_length; i++)
+    {
+      const DataReference reference = code.references[i];
+      const size_t target = code_size + reference.data_offset;
+      const size_t end = reference.where.position + 4 + reference.immediate_size;
+      const u32 displacement = target - end;
+      memcpy (map + reference.where.position, &displacement, sizeof (displacement));
+    }
+
+  const size_t entry = label_offset (&code, code.entry);
+  free_code (&code);
+
+  if (mprotect (map, code_size, PROT_READ|PROT_EXEC) != 0)
+    {
+      error (0, errno, _("failed to make the program executable"));
+      munmap (map, code_size + data_size);
+      return EXIT_FAILURE;
+    }
+
+  void (*program) (void) = (void (*) (void)) (map + entry);
+  program ();
+
+  munmap (map, code_size + data_size);
+
+  return 0;
+}
+
+void *
+map_function (const CodeBuffer *code, void **map, size_t *map_size)
+{
+  const size_t page_size = sysconf (_SC_PAGESIZE);
+  const size_t size = (code->length + page_size - 1) / page_size * page_size;
+
+  u8 *bytes = mmap (NULL, size, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (bytes == MAP_FAILED)
+    return NULL;
+
+  memcpy (bytes, code->bytes, code->length);
+  if (mprotect (bytes, size, PROT_READ|PROT_EXEC) != 0)
+    {
+      munmap (bytes, size);
+      return NULL;
+    }
+
+  *map = bytes;
+  *map_size = size;
+  return bytes + label_offset (code, code->entry);
+}
@@ -0,0 +1,37 @@
+/*  jit.h
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#ifndef _JIT_H
+#define _JIT_H 1
+
+#include "encoder.h"
+#include "tokenizer.h"
+
+#include "system.h"
+
+/* Translates tokenized source to machine code in memory and runs it.  */
+extern int run_program (const ProgramSource *const source)
+  __nonnull ((1));
+
+/* Maps finished machine CODE, which has no data area, as executable
+   memory.  Returns its entry, or NULL on failure.  The mapping is stored
+   to MAP and MAP_SIZE for munmap ().  */
+extern void *map_function (const CodeBuffer *code, void **map, size_t *map_size)
+  __nonnull ((1, 2, 3));
+
+#endif /* _JIT_H */
@@ -0,0 +1,341 @@
+/*  linker.c
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include <config.h>
+
+#include "linker.h"
+
+#include <elf.h>
+#include <inttypes.h>
+#include <error.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "system.h"
+
+#include "compiler.h"
+#include "xalloc.h"
+
+/* Where the executable is loaded, the same as ld uses.  */
+#define TEXT_ADDRESS 0x400000
+#define PAGE_SIZE    0x1000
+
+#define ROUND_UP(n, alignment) (((n) + (alignment) - 1) / (alignment) * (alignment))
+
+/* Resolve references of CODE placed at CODE_ADDRESS to its data area
+   at DATA_ADDRESS, in the copy of the code at BYTES.  */
+static void
+resolve_references (u8 *bytes, const CodeBuffer *code,
+                    u64 code_address, u64 data_address)
+{
+  for (size_t i = 0; i < code->references_length; i++)
+    {
+      const DataReference reference = code->references[i];
+      const u64 end = code_address + reference.where.position + 4 + reference.immediate_size;
+      const u32 displacement = data_address + reference.data_offset - end;
+      memcpy (bytes + reference.where.position, &displacement, sizeof (displacement));
+    }
+}
+
+/* The executable has the headers and the code in one read-only
+   executable segment and the data area in a writable segment.  Only
+   the initialized start of the data area is in the file, the loader
+   zeroes the rest.  */
+int
+write_executable (const char *filename,
+                  const CodeBuffer *code)
+{
+  enum { TEXT_SEGMENT, DATA_SEGMENT, STACK_SEGMENT, SEGMENTS };
+
+  const size_t code_offset = ROUND_UP (sizeof (Elf64_Ehdr) + SEGMENTS * sizeof (Elf64_Phdr), 16);
+  const size_t text_size = code_offset + code->length;
+  /* File offset and address of a segment have to be equal modulo the
+     page size.  The data area is aligned for vector loads.  */
+  const size_t data_offset = ROUND_UP (text_size, 64);
+  const u64 data_address = ROUND_UP (TEXT_ADDRESS + text_size, PAGE_SIZE) + data_offset % PAGE_SIZE;
+
+  const size_t image_size = code->data_length != 0 ? data_offset + code->data_length : text_size;
+
+  u8 *image = xcalloc (image_size, 1);
+  Elf64_Ehdr *header = (Elf64_Ehdr *) image;
+  Elf64_Phdr *segments = (Elf64_Phdr *) (image + sizeof (*header));
+
+  memcpy (header->e_ident, ELFMAG, SELFMAG);
+  header->e_ident[EI_CLASS] = ELFCLASS64;
+  header->e_ident[EI_DATA] = ELFDATA2LSB;
+  header->e_ident[EI_VERSION] = EV_CURRENT;
+  header->e_ident[EI_OSABI] = ELFOSABI_SYSV;
+  header->e_type = ET_EXEC;
+  header->e_machine = EM_X86_64;
+  header->e_version = EV_CURRENT;
+  header->e_entry = TEXT_ADDRESS + code_offset + label_offset (code, code->entry);
+  header->e_phoff = sizeof (*header);
+  header->e_ehsize = sizeof (*header);
+  header->e_phentsize = sizeof (*segments);
+  header->e_phnum = SEGMENTS;
+  header->e_shentsize = sizeof (Elf64_Shdr);
+  header->e_shstrndx = SHN_UNDEF;
+
+  segments[TEXT_SEGMENT].p_type = PT_LOAD;
+  segments[TEXT_SEGMENT].p_flags = PF_R|PF_X;
+  segments[TEXT_SEGMENT].p_offset = 0;
+  segments[TEXT_SEGMENT].p_vaddr = TEXT_ADDRESS;
+  segments[TEXT_SEGMENT].p_paddr = TEXT_ADDRESS;
+  segments[TEXT_SEGMENT].p_filesz = text_size;
+  segments[TEXT_SEGMENT].p_memsz = text_size;
+  segments[TEXT_SEGMENT].p_align = PAGE_SIZE;
+
+  segments[DATA_SEGMENT].p_type = PT_LOAD;
+  segments[DATA_SEGMENT].p_flags = PF_R|PF_W;
+  segments[DATA_SEGMENT].p_offset = data_offset;
+  segments[DATA_SEGMENT].p_vaddr = data_address;
+  segments[DATA_SEGMENT].p_paddr = data_address;
+  segments[DATA_SEGMENT].p_filesz = code->data_length;
+  segments[DATA_SEGMENT].p_memsz = code->data_size;
+  segments[DATA_SEGMENT].p_align = PAGE_SIZE;
+
+  /* Stack is not executable.  */
+  segments[STACK_SEGMENT].p_type = PT_GNU_STACK;
+  segments[STACK_SEGMENT].p_flags = PF_R|PF_W;
+  segments[STACK_SEGMENT].p_align = 16;
+
+  memcpy (image + code_offset, code->bytes, code->length);
+  resolve_references (image + code_offset, code, TEXT_ADDRESS + code_offset, data_address);
+  if (code->data_length != 0)
+    memcpy (image + data_offset, code->data, code->data_length);
+
+  /* Start from a new file, so it gets the mode of an executable.  */
+  if (unlink (filename) != 0 && errno != ENOENT)
+    {
+      error (0, errno, "%s", quotef (filename));
+      free (image);
+      return -1;
+    }
+
+  int err = write_file (filename, (const char *) image, image_size, 0777);
+  free (image);
+  return err;
+}
+
+/* Contents of a file being built.  */
+typedef struct
+{
+  u8 *bytes;
+  size_t length;
+  size_t alloc;
+} Image;
+
+static size_t
+append (Image *image, const void *bytes, size_t n)
+{
+  const size_t offset = image->length;
+  while (image->alloc - image->length < n)
+    image->bytes = x2nrealloc (image->bytes, &image->alloc, sizeof (*image->bytes));
+  memcpy (image->bytes + image->length, bytes, n);
+  image->length += n;
+  return offset;
+}
+
+static size_t
+align (Image *image, size_t alignment)
+{
+  static const u8 zeros[64];
+  append (image, zeros, ROUND_UP (image->length, alignment) - image->length);
+  return image->length;
+}
+
+static void
+add_symbol (Image *symbols, Image *strings, const char *name,
+            u8 info, u16 section, u64 value, u64 size)
+{
+  Elf64_Sym symbol;
+  memset (&symbol, 0, sizeof (symbol));
+  if (name != NULL)
+    symbol.st_name = append (strings, name, strlen (name) + 1);
+  symbol.st_info = info;
+  symbol.st_shndx = section;
+  symbol.st_value = value;
+  symbol.st_size = size;
+  append (symbols, &symbol, sizeof (symbol));
+}
+
+/* The object has the code in .text and the data area in .bss, or in
+   .data if a part of it is initialized.  The references to the data
+   area become relocations against that section.  Every
+   named label and part of the data area gets a symbol, _start is the
+   only global one.  */
+int
+write_object (const char *filename,
+              const CodeBuffer *code)
+{
+  enum
+  {
+    NULL_SECTION, TEXT_SECTION, RELA_TEXT_SECTION, DATA_SECTION,
+    NOTE_STACK_SECTION, SYMTAB_SECTION, STRTAB_SECTION, SHSTRTAB_SECTION,
+    SECTIONS
+  };
+  const char *const section_names[SECTIONS] =
+  {
+    "", ".text", ".rela.text", code->data_length != 0 ? ".data" : ".bss",
+    ".note.GNU-stack", ".symtab", ".strtab", ".shstrtab"
+  };
+
+  Image image = { NULL, 0, 0 };
+  Image symbols = { NULL, 0, 0 };
+  Image strings = { NULL, 0, 0 };
+  Image section_strings = { NULL, 0, 0 };
+  Elf64_Shdr sections[SECTIONS];
+  memset (sections, 0, sizeof (sections));
+
+  Elf64_Ehdr header;
+  memset (&header, 0, sizeof (header));
+  append (&image, &header, sizeof (header));
+
+  sections[TEXT_SECTION].sh_type = SHT_PROGBITS;
+  sections[TEXT_SECTION].sh_flags = SHF_ALLOC|SHF_EXECINSTR;
+  sections[TEXT_SECTION].sh_offset = align (&image, 16);
+  sections[TEXT_SECTION].sh_size = code->length;
+  sections[TEXT_SECTION].sh_addralign = 16;
+  append (&image, code->bytes, code->length);
+
+  sections[RELA_TEXT_SECTION].sh_type = SHT_RELA;
+  sections[RELA_TEXT_SECTION].sh_flags = SHF_INFO_LINK;
+  sections[RELA_TEXT_SECTION].sh_offset = align (&image, 8);
+  sections[RELA_TEXT_SECTION].sh_link = SYMTAB_SECTION;
+  sections[RELA_TEXT_SECTION].sh_info = TEXT_SECTION;
+  sections[RELA_TEXT_SECTION].sh_addralign = 8;
+  sections[RELA_TEXT_SECTION].sh_entsize = sizeof (Elf64_Rela);
+  for (size_t i = 0; i < code->references_length; i++)
+    {
+      const DataReference reference = code->references[i];
+      /* Symbol 2 is the section symbol of the data area, see below.  */
+      Elf64_Rela relocation;
+      relocation.r_offset = reference.where.position;
+      relocation.r_info = ELF64_R_INFO (2, R_X86_64_PC32);
+      relocation.r_addend = (i64) reference.data_offset - 4 - reference.immediate_size;
+      append (&image, &relocation, sizeof (relocation));
+    }
+  sections[RELA_TEXT_SECTION].sh_size = image.length - sections[RELA_TEXT_SECTION].sh_offset;
+
+  sections[DATA_SECTION].sh_flags = SHF_ALLOC|SHF_WRITE;
+  sections[DATA_SECTION].sh_size = code->data_size;
+  sections[DATA_SECTION].sh_addralign = 64;
+  if (code->data_length != 0)
+    {
+      sections[DATA_SECTION].sh_type = SHT_PROGBITS;
+      u8 *data = xcalloc (code->data_size, 1);
+      memcpy (data, code->data, code->data_length);
+      sections[DATA_SECTION].sh_offset = align (&image, 64);
+      append (&image, data, code->data_size);
+      free (data);
+    }
+  else
+    {
+      sections[DATA_SECTION].sh_type = SHT_NOBITS;
+      sections[DATA_SECTION].sh_offset = image.length;
+    }
+
+  sections[NOTE_STACK_SECTION].sh_type = SHT_PROGBITS;
+  sections[NOTE_STACK_SECTION].sh_offset = image.length;
+  sections[NOTE_STACK_SECTION].sh_addralign = 1;
+
+  /* Local symbols have to precede global ones.  */
+  append (&strings, "", 1);
+  add_symbol (&symbols, &strings, NULL, 0, SHN_UNDEF, 0, 0);
+  add_symbol (&symbols, &strings, NULL, ELF64_ST_INFO (STB_LOCAL, STT_SECTION), TEXT_SECTION, 0, 0);
+  add_symbol (&symbols, &strings, NULL, ELF64_ST_INFO (STB_LOCAL, STT_SECTION), DATA_SECTION, 0, 0);
+  for (size_t i = 0; i < code->data_symbols_length; i++)
+    {
+      const DataSymbol *symbol = &code->data_symbols[i];
+      add_symbol (&symbols, &strings, symbol->name, ELF64_ST_INFO (STB_LOCAL, STT_OBJECT),
+                  DATA_SECTION, symbol->offset, symbol->size);
+    }
+  for (size_t i = 0; i < code->labels_length; i++)
+    {
+      const CodeLabel *label = &code->labels[i];
+      if (label->name == NULL || !label->bound || i == code->entry)
+        continue;
+
+      char name[64];
+      if (label->index >= 0)
+        snprintf (name, sizeof (name), "%s%" PRIi32, label->name, label->index);
+      else
+        snprintf (name, sizeof (name), "%s", label->name);
+      add_symbol (&symbols, &strings, name,
+                  ELF64_ST_INFO (STB_LOCAL, label->function ? STT_FUNC : STT_NOTYPE),
+                  TEXT_SECTION, label->where.position, 0);
+    }
+  const size_t first_global = symbols.length / sizeof (Elf64_Sym);
+  const CodeLabel *entry = &code->labels[code->entry];
+  add_symbol (&symbols, &strings, entry->name, ELF64_ST_INFO (STB_GLOBAL, STT_FUNC),
+              TEXT_SECTION, entry->where.position, 0);
+
+  sections[SYMTAB_SECTION].sh_type = SHT_SYMTAB;
+  sections[SYMTAB_SECTION].sh_offset = align (&image, 8);
+  sections[SYMTAB_SECTION].sh_size = symbols.length;
+  sections[SYMTAB_SECTION].sh_link = STRTAB_SECTION;
+  sections[SYMTAB_SECTION].sh_info = first_global;
+  sections[SYMTAB_SECTION].sh_addralign = 8;
+  sections[SYMTAB_SECTION].sh_entsize = sizeof (Elf64_Sym);
+  append (&image, symbols.bytes, symbols.length);
+
+  sections[STRTAB_SECTION].sh_type = SHT_STRTAB;
+  sections[STRTAB_SECTION].sh_offset = image.length;
+  sections[STRTAB_SECTION].sh_size = strings.length;
+  sections[STRTAB_SECTION].sh_addralign = 1;
+  append (&image, strings.bytes, strings.length);
+
+  for (size_t i = 0; i < SECTIONS; i++)
+    sections[i].sh_name = append (&section_strings, section_names[i],
+                                  strlen (section_names[i]) + 1);
+  sections[SHSTRTAB_SECTION].sh_type = SHT_STRTAB;
+  sections[SHSTRTAB_SECTION].sh_offset = image.length;
+  sections[SHSTRTAB_SECTION].sh_size = section_strings.length;
+  sections[SHSTRTAB_SECTION].sh_addralign = 1;
+  append (&image, section_strings.bytes, section_strings.length);
+
+  /* The null section has no name.  */
+  sections[NULL_SECTION].sh_name = 0;
+
+  memcpy (header.e_ident, ELFMAG, SELFMAG);
+  header.e_ident[EI_CLASS] = ELFCLASS64;
+  header.e_ident[EI_DATA] = ELFDATA2LSB;
+  header.e_ident[EI_VERSION] = EV_CURRENT;
+  header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+  header.e_type = ET_REL;
+  header.e_machine = EM_X86_64;
+  header.e_version = EV_CURRENT;
+  header.e_shoff = align (&image, 8);
+  header.e_ehsize = sizeof (header);
+  header.e_shentsize = sizeof (Elf64_Shdr);
+  header.e_shnum = SECTIONS;
+  header.e_shstrndx = SHSTRTAB_SECTION;
+  append (&image, sections, sizeof (sections));
+  memcpy (image.bytes, &header, sizeof (header));
+
+  int err = write_file (filename, (const char *) image.bytes, image.length, 0644);
+
+  free (section_strings.bytes);
+  free (strings.bytes);
+  free (symbols.bytes);
+  free (image.bytes);
+
+  return err;
+}
@@ -0,0 +1,38 @@
+/*  linker.h
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#ifndef _LINKER_H
+#define _LINKER_H 1
+
+#include "encoder.h"
+
+#include "system.h"
+
+/* Writes finished machine CODE as static ELF executable, without
+   running the assembler and the linker.  */
+extern int write_executable (const char *filename,
+                             const CodeBuffer *code)
+  __nonnull ((1, 2));
+
+/* Writes finished machine CODE as ELF relocatable object, without
+   running the assembler.  */
+extern int write_object (const char *filename,
+                         const CodeBuffer *code)
+  __nonnull ((1, 2));
+
+#endif /* _LINKER_H */
@@ -43,8 +43,8 @@ RELEASE_YEAR = \
   `sed -n '/.*COPYRIGHT_YEAR = \([0-9][0-9][0-9][0-9]\) };/s//\1/p' \
     $(top_srcdir)/lib/version-etc.c`
 
-src_bfc_LDADD    = $(LDADD)
-src_bfc_SOURCES  = src/main.c src/compiler.c src/tokenizer.c src/optimizer.c src/arch.c
+src_bfc_LDADD    = $(LDADD) $(LIBPMULTITHREAD)
+src_bfc_SOURCES  = src/main.c src/cache.c src/stats.c src/classify.c src/compiler.c src/encoder.c src/evaluator.c src/interpreter.c src/jit.c src/linker.c src/tokenizer.c src/optimizer.c src/profile.c src/arch.c
 src_bfc_CFLAGS   = $(AM_CFLAGS)
 src_bfc_CPPFLAGS = $(AM_CPPFLAGS)
 
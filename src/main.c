@@ -32,10 +32,18 @@
 #include "system.h"
 
 #include "arch.h"
+#include "cache.h"
+#include "classify.h"
 #include "compiler.h"
+#include "interpreter.h"
+#include "jit.h"
+#include "linker.h"
 #include "tokenizer.h"
 #include "optimizer.h"
+#include "profile.h"
+#include "stats.h"
 
+#include "argmatch.h"
 #include "configmake.h"
 #include "die.h"
 #include "filenamecat.h"
@@ -55,12 +63,7 @@ static inline __nonnull ((1)) void
 strip_comments (char **source, size_t length)
 {
   char *s = *source;
-  size_t j = 0;
-  for (size_t i = 0; i < length; i++)
-    if (parse_token (s[i]) != T_COMMENT)
-      s[j++] = s[i];
-  if (j == 0)
-    j = 1;
+  size_t j = strip_non_commands (s, length);
   s[j] = '\0';
   *source = &s[j];
 }
@@ -92,7 +95,7 @@ read_file (const char *filename, char **content, size_t *content_len)
           if (len == 0 && fclose (fp) == 0)
             {
               *content_len = s - buf;
-              *content = xrealloc (buf, s - buf);
+              *content = xrealloc (buf, s - buf + 1);
               return;
             }
         }
@@ -134,9 +137,16 @@ static char *out_filename              = "";
 static bool do_assemble                = true;
 static bool do_link                    = true;
 static bool save_temps                 = false;
+static bool use_pipes                  = false;
 static bool with_debug_info            = false;
+static bool run_in_memory              = false;
+static bool interpret                  = false;
+static bool tiered                     = false;
+static bool profile_generate           = false;
+static const char *profile_report      = NULL;
 static unsigned int optimization_level = 0;
 static unsigned int files_to_compile   = 0;
+static unsigned int jobs               = 1;
 
 void
 usage (int status)
@@ -146,15 +156,37 @@ usage (int status)
   else
     {
       printf (_("\
-Usage: %s [-scgo:O:]\n"), program_name);
+Usage: %s [-scgo:O:j:f:]\n"), program_name);
       puts (_("\
   --help                   Display this information and exit.\n\
   --version                Display compiler's version and exit.\n\
   --save-temps             Do not delete temporary files.\n\
+  --cache-dir=<dir>        Reuse the results of earlier compilations kept in <dir>.\n\
+  --cache-size=<size>      Keep up to <size> bytes in the cache, 256M by default.\n\
+  --pipe                   Assemble with as, piping the assembly source code\n\
+                           to it instead of writing a temporary file.\n\
+  --run                    Run the program in memory instead of compiling it.\n\
+  --interpret              Interpret the program instead of compiling it.\n\
+  --tiered                 Interpret the program and compile its hot loops\n\
+                           in the background.\n\
+  --output-buffer=<size>   Buffer up to <size> bytes of the program output.\n\
+  --eof=<policy>           Set the cell at the end of input: 'unchanged' (default),\n\
+                           'zero' or 'minus-one'.\n\
+  --stats[=<format>]       Print the time and memory used by every phase of\n\
+                           the compilation as 'text' (default) or 'json'.\n\
+  -ftime-report            Same as --stats=text.\n\
+  -fprofile-generate       Count how many times every loop runs and write\n\
+                           the counts to <file>.prof at exit.  Loops turned\n\
+                           into sets, multiplications or scans are not\n\
+                           counted.  The program is not run at compile time,\n\
+                           so -O2 is the same as -O1.\n\
+  --profile-report=<prof>  Print the loop counts of the profile <prof>\n\
+                           written by the program compiled from <file>.\n\
   -s                       Compile only, do not assemble or link.\n\
   -c                       Compile and assemble, but do not link.\n\
   -g                       Generate debug information.\n\
   -o <file>                Place the output into <file>.\n\
+  -j <n>                   Compile up to <n> files at the same time.\n\
   -On                      Level of optimization, default is 0."));
     }
 
@@ -163,12 +195,52 @@ Usage: %s [-scgo:O:]\n"), program_name);
 
 enum
 {
-  SAVE_TEMPS_OPTION = CHAR_MAX + 1
+  SAVE_TEMPS_OPTION = CHAR_MAX + 1,
+  PIPE_OPTION,
+  CACHE_DIR_OPTION,
+  CACHE_SIZE_OPTION,
+  RUN_OPTION,
+  INTERPRET_OPTION,
+  TIERED_OPTION,
+  OUTPUT_BUFFER_OPTION,
+  EOF_OPTION,
+  STATS_OPTION,
+  PROFILE_REPORT_OPTION
 };
 
+static char const *const eof_args[] =
+{
+  "unchanged", "zero", "minus-one", NULL
+};
+static EofPolicy const eof_types[] =
+{
+  EOF_UNCHANGED, EOF_ZERO, EOF_MINUS_ONE
+};
+ARGMATCH_VERIFY (eof_args, eof_types);
+
+static char const *const stats_args[] =
+{
+  "text", "json", NULL
+};
+static StatsFormat const stats_types[] =
+{
+  STATS_TEXT, STATS_JSON
+};
+ARGMATCH_VERIFY (stats_args, stats_types);
+
 static const struct option long_options[] =
 {
   {"save-temps", no_argument, NULL, SAVE_TEMPS_OPTION},
+  {"pipe", no_argument, NULL, PIPE_OPTION},
+  {"cache-dir", required_argument, NULL, CACHE_DIR_OPTION},
+  {"cache-size", required_argument, NULL, CACHE_SIZE_OPTION},
+  {"run", no_argument, NULL, RUN_OPTION},
+  {"interpret", no_argument, NULL, INTERPRET_OPTION},
+  {"tiered", no_argument, NULL, TIERED_OPTION},
+  {"output-buffer", required_argument, NULL, OUTPUT_BUFFER_OPTION},
+  {"eof", required_argument, NULL, EOF_OPTION},
+  {"stats", optional_argument, NULL, STATS_OPTION},
+  {"profile-report", required_argument, NULL, PROFILE_REPORT_OPTION},
   {NULL, 0, NULL, '\0'}
 };
 
@@ -203,7 +275,7 @@ parseopt (int argc, char **argv)
   parse_long_options (argc, argv, PROGRAM_NAME, PACKAGE_NAME, Version, usage, AUTHORS,
                       (const char *) NULL);
 
-  while ((optc = getopt_long (argc, argv, "o:O:scg", long_options, NULL)) >= 0)
+  while ((optc = getopt_long (argc, argv, "o:O:scgj:f:", long_options, NULL)) >= 0)
     switch (optc)
       {
       case 'o':
@@ -215,10 +287,10 @@ parseopt (int argc, char **argv)
         if (*optarg == '\0' || *(optarg + 1) != '\0' || (*optarg < '0' && *optarg > '9'))
           error (0, 0, _("invalid optimization level %s"), optarg);
         optimization_level = *optarg - '0';
-        if (optimization_level > 1)
-          /* Maximum optimization level is first, if after '-O' costs 2
-             or greater number, then replace it by 1.  */
-          optimization_level = 1;
+        if (optimization_level > 2)
+          /* Maximum optimization level is second, if after '-O' costs 3
+             or greater number, then replace it by 2.  */
+          optimization_level = 2;
         break;
       case 's':
         do_assemble = do_link = false;
@@ -229,9 +301,59 @@ parseopt (int argc, char **argv)
       case 'g':
         with_debug_info = true;
         break;
+      case 'j':
+        jobs = xdectoumax (optarg, 1, INT_MAX, "",
+                           _("invalid number of jobs"), 0);
+        break;
+      case 'f':
+        if (strcmp (optarg, "time-report") == 0)
+          stats_format = STATS_TEXT;
+        else if (strcmp (optarg, "profile-generate") == 0)
+          profile_generate = true;
+        else
+          {
+            error (0, 0, _("unrecognized option '-f%s'"), optarg);
+            usage (EXIT_FAILURE);
+          }
+        break;
       case SAVE_TEMPS_OPTION:
         save_temps = true;
         break;
+      case PIPE_OPTION:
+        use_pipes = true;
+        break;
+      case CACHE_DIR_OPTION:
+        if (*optarg == '\0')
+          die (EXIT_TROUBLE, 0, _("cache directory cannot be empty."));
+        cache_directory = optarg;
+        break;
+      case CACHE_SIZE_OPTION:
+        cache_size_limit = xdectoumax (optarg, 0, UINTMAX_MAX, "kKMG",
+                                       _("invalid cache size"), 0);
+        break;
+      case RUN_OPTION:
+        run_in_memory = true;
+        break;
+      case INTERPRET_OPTION:
+        run_in_memory = interpret = true;
+        break;
+      case TIERED_OPTION:
+        run_in_memory = interpret = tiered = true;
+        break;
+      case OUTPUT_BUFFER_OPTION:
+        output_buffer_size = xdectoumax (optarg, 1, 1 << 30, "kKMG",
+                                         _("invalid output buffer size"), 0);
+        break;
+      case EOF_OPTION:
+        eof_policy = XARGMATCH ("--eof", optarg, eof_args, eof_types);
+        break;
+      case STATS_OPTION:
+        stats_format = optarg == NULL ? STATS_TEXT
+                       : XARGMATCH ("--stats", optarg, stats_args, stats_types);
+        break;
+      case PROFILE_REPORT_OPTION:
+        profile_report = optarg;
+        break;
       default:
         diagnose_leading_hyphen (argc, argv);
         usage (EXIT_FAILURE);
@@ -253,6 +375,13 @@ parseopt (int argc, char **argv)
     die (EXIT_FAILURE, 0, _("fatal error: no input files."));
   if (files_to_compile > 1 && *out_filename != '\0')
     die (EXIT_FAILURE, 0, _("files to compile more than one and output filename set."));
+  if (profile_generate && run_in_memory)
+    die (EXIT_FAILURE, 0, _("-fprofile-generate cannot be used with --run, --interpret or --tiered."));
+  if (profile_generate && optimization_level > 1)
+    /* Loops run at compile time would be missing from the profile.  */
+    optimization_level = 1;
+  if (profile_report != NULL && files_to_compile > 1)
+    die (EXIT_FAILURE, 0, _("--profile-report takes the source of one program."));
 }
 
 static size_t
@@ -296,12 +425,66 @@ mktmp (const char *template, size_t suff_len)
   return tmpfile;
 }
 
+/* Read FILENAME and translate it to tokens, exit on failure.  */
+static void
+read_source (const char *filename, char **source, size_t *source_len)
+{
+  stats_begin (PHASE_READ);
+  read_file (filename, source, source_len);
+  stats_end (PHASE_READ);
+  if (*source == NULL)
+    die (EXIT_FAILURE, 0, _("fatal error: failed to read file %s"), quoteaf (filename));
+}
+
+/* Tokenizes SOURCE and frees it.  */
+static void
+parse_source (char *source, size_t source_len, ProgramSource *tokenized_source)
+{
+  /* Interpret symbols.  */
+  int err = tokenize_and_optimize (source, source_len, tokenized_source, optimization_level);
+  free (source);
+  if (err != 0)
+    {
+      error (0, 0, _("error code: %i"), err);
+      exit (err);
+    }
+}
+
+static void
+parse_file (const char *filename, ProgramSource *tokenized_source)
+{
+  char *source;
+  size_t source_len;
+  read_source (filename, &source, &source_len);
+  parse_source (source, source_len, tokenized_source);
+}
+
 static int
-compile_file (char *filename)
+run_file (const char *filename)
+{
+  ProgramSource tokenized_source;
+  parse_file (filename, &tokenized_source);
+
+  stats_begin (PHASE_RUN);
+  int err = interpret ? interpret_program (&tokenized_source, tiered)
+                      : run_program (&tokenized_source);
+  stats_end (PHASE_RUN);
+
+  free_program_source (&tokenized_source);
+  print_stats (stderr, filename);
+
+  return err;
+}
+
+/* Compile SOURCE to ELF_FILENAME through assembly source, the
+   assembler and the linker.  */
+static int
+compile_with_binutils (const char *clean_filename,
+                       ProgramSource *tokenized_source,
+                       char *elf_filename)
 {
   char *out_asm = NULL;
   char *out_obj = NULL;
-  char *clean_filename = cut_path (filename);
   const size_t clean_filename_len = strlen (clean_filename);
 
   if (save_temps || !do_link)
@@ -322,7 +505,8 @@ compile_file (char *filename)
             }
           else
             {
-              out_asm = mktmp ("bfc-XXXXXXXXXXXX.s", 2);
+              if (!use_pipes)
+                out_asm = mktmp ("bfc-XXXXXXXXXXXX.s", 2);
 
               out_obj = xstrndup (clean_filename, clean_filename_len);
               change_extension (out_obj, ".o");
@@ -337,8 +521,8 @@ compile_file (char *filename)
           out_asm = xstrndup (clean_filename, clean_filename_len);
           out_obj = xstrndup (clean_filename, clean_filename_len);
 
-          change_extension (clean_filename, ".s");
-          change_extension (clean_filename, ".o");
+          change_extension (out_asm, ".s");
+          change_extension (out_obj, ".o");
 
           fd = open (out_asm, flags, mode);
           if (fd < 0 || close (fd) != 0)
@@ -351,68 +535,218 @@ compile_file (char *filename)
     }
   else
     {
-      out_asm = mktmp ("bfc-XXXXXXXXXXXX.s", 2);
+      if (!use_pipes)
+        out_asm = mktmp ("bfc-XXXXXXXXXXXX.s", 2);
       out_obj = mktmp ("bfc-XXXXXXXXXXXX.o", 2);
     }
 
-  bool out_filename_was_allocated = false;
-  if (*out_filename == '\0')
-    {
-      out_filename = xmalloc (clean_filename_len + 1);
-      snprintf (out_filename, clean_filename_len + 1, "%s", clean_filename);
-      change_extension (out_filename, "");
-      out_filename_was_allocated = true;
-    }
-
-  ProgramSource tokenized_source;
-
-  /* Open file.  */
-  char *source;
-  size_t source_len;
-  read_file (filename, &source, &source_len);
-  if (source == NULL)
-    die (EXIT_FAILURE, 0, _("fatal error: failed to read file %s"), quoteaf (filename));
-
-  /* Interpret symbols.  */
-  int err = tokenize_and_optimize (source, source_len, &tokenized_source, optimization_level);
-  if (err != 0)
+  /* Without OUT_ASM the assembly source code is piped to the
+     assembler, and it is generated while the assembler runs.  */
+  int err = 0;
+  if (out_asm != NULL)
     {
-      error (0, 0, _("error code: %i"), err);
-      free (source);
-      exit (err);
+      stats_begin (PHASE_GENERATE);
+      err = translate_to_asm (out_asm, tokenized_source);
+      stats_end (PHASE_GENERATE);
+      if (err != 0)
+        error (0, 0, _("error code: %i"), err);
     }
 
-  err = translate_to_asm (out_asm, &tokenized_source);
-  if (err != 0)
-    error (0, 0, _("error code: %i"), err);
-
-  free (tokenized_source.tokens);
-  free (source);
-
   if (err == 0 && do_assemble)
     {
-      err = compile_to_obj (out_asm, out_obj);
+      stats_begin (PHASE_ASSEMBLE);
+      err = compile_to_obj (out_asm, out_obj, tokenized_source);
+      stats_end (PHASE_ASSEMBLE);
 
       if (err == 0 && do_link)
-        err = link_to_elf (out_obj, out_filename, with_debug_info);
+        {
+          stats_begin (PHASE_LINK);
+          err = link_to_elf (out_obj, elf_filename, with_debug_info);
+          stats_end (PHASE_LINK);
+        }
     }
 
   if (!save_temps || err != 0)
     {
-      if (do_assemble)
+      if (do_assemble && out_asm != NULL)
         unlink (out_asm);
       if (do_link)
         unlink (out_obj);
     }
 
-  if (out_filename_was_allocated)
-    free (out_filename);
   free (out_obj);
   free (out_asm);
 
   return err;
 }
 
+/* Writes to SETTINGS everything besides the source that changes the
+   result of compiling it.  */
+static void
+describe_settings (char *settings, size_t size)
+{
+  snprintf (settings, size, "bfc %s %s -O%u%s%s%s --output-buffer=%u --eof=%s%s%s",
+            Version, target_name, optimization_level,
+            with_debug_info ? " -g" : "",
+            !do_assemble ? " -s" : !do_link ? " -c" : "",
+            use_pipes ? " --pipe" : "",
+            output_buffer_size, eof_args[eof_policy],
+            profile_filename != NULL ? " -fprofile-generate " : "",
+            profile_filename != NULL ? profile_filename : "");
+}
+
+/* Compiles SOURCE, which is freed, to ELF_FILENAME or, without
+   linking, to RESULT_FILENAME.  */
+static int
+compile_source (const char *clean_filename, char *source, size_t source_len,
+                char *elf_filename, const char *result_filename)
+{
+  ProgramSource tokenized_source;
+  parse_source (source, source_len, &tokenized_source);
+
+  int err;
+  CodeBuffer code;
+  init_code (&code);
+
+  /* Unless temporary files, debug information, a profile or the
+     assembler are wanted, the object or the executable is written
+     directly, if there is an encoder for this architecture.  */
+  bool encoded = false;
+  if (do_assemble && !save_temps && !(do_link && with_debug_info)
+      && profile_filename == NULL && !use_pipes)
+    {
+      stats_begin (PHASE_GENERATE);
+      encoded = tokens_to_code (&tokenized_source, &code, false);
+      stats_end (PHASE_GENERATE);
+    }
+
+  if (encoded)
+    {
+      stats_begin (PHASE_WRITE);
+      if (do_link)
+        err = write_executable (elf_filename, &code);
+      else
+        err = write_object (result_filename, &code);
+      stats_end (PHASE_WRITE);
+    }
+  else
+    err = compile_with_binutils (clean_filename, &tokenized_source, elf_filename);
+
+  free_code (&code);
+  free_program_source (&tokenized_source);
+
+  return err;
+}
+
+static int
+compile_file (char *filename)
+{
+  char *clean_filename = cut_path (filename);
+  const size_t clean_filename_len = strlen (clean_filename);
+
+  char *elf_filename = out_filename;
+  if (*out_filename == '\0')
+    {
+      elf_filename = xstrndup (clean_filename, clean_filename_len);
+      change_extension (elf_filename, "");
+    }
+
+  /* The file the compilation produces.  */
+  char *result_filename = elf_filename;
+  if (!do_link)
+    {
+      result_filename = xstrndup (clean_filename, clean_filename_len);
+      change_extension (result_filename, do_assemble ? ".o" : ".s");
+    }
+
+  /* The program writes its profile to the directory it runs in.  */
+  char *profile_name = NULL;
+  if (profile_generate)
+    {
+      profile_name = xstrndup (clean_filename, clean_filename_len);
+      change_extension (profile_name, ".prof");
+      profile_filename = profile_name;
+    }
+
+  char *source;
+  size_t source_len;
+  read_source (filename, &source, &source_len);
+
+  int err = 0;
+  CacheKey key;
+  bool use_cache = cache_directory != NULL && !save_temps;
+  if (use_cache)
+    {
+      char settings[256 + PATH_MAX];
+      describe_settings (settings, sizeof (settings));
+      cache_key (&key, source, source_len, settings);
+    }
+
+  if (!use_cache || !cache_fetch (&key, result_filename))
+    {
+      err = compile_source (clean_filename, source, source_len,
+                            elf_filename, result_filename);
+      if (err == 0 && use_cache)
+        cache_store (&key, result_filename);
+    }
+  else
+    free (source);
+
+  print_stats (stderr, filename);
+
+  profile_filename = NULL;
+  free (profile_name);
+  if (result_filename != elf_filename)
+    free (result_filename);
+  if (elf_filename != out_filename)
+    free (elf_filename);
+
+  return err;
+}
+
+/* Compiles the COUNT files of FILES in child processes, up to JOBS of
+   them at the same time.  Returns the number of failed files.  */
+static int
+compile_files_in_parallel (char **files, int count)
+{
+  int failed = 0;
+  unsigned int running = 0;
+
+  /* Nothing buffered may be written twice by the children.  */
+  fflush (stdout);
+  fflush (stderr);
+
+  for (int i = 0; i < count || running > 0;)
+    {
+      if (i < count && running < jobs)
+        {
+          pid_t pid = fork ();
+          if (pid < 0)
+            die (EXIT_FAILURE, errno, "fork()");
+          else if (pid == 0)
+            exit (compile_file (files[i]) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+
+          running++;
+          i++;
+          continue;
+        }
+
+      int status;
+      if (waitpid (-1, &status, 0) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          die (EXIT_FAILURE, errno, "waitpid()");
+        }
+
+      running--;
+      if (!WIFEXITED (status) || WEXITSTATUS (status) != EXIT_SUCCESS)
+        failed++;
+    }
+
+  return failed;
+}
+
 int
 main (int argc, char **argv)
 {
@@ -432,8 +766,13 @@ main (int argc, char **argv)
 
   int err = 0;
 
-  for (int i = 0; i < argc; i++)
-    err += compile_file (argv[i]);
+  if (profile_report != NULL)
+    err = !report_profile (stdout, profile_report, argv[0]);
+  else if (!run_in_memory && jobs > 1 && argc > 1)
+    err = compile_files_in_parallel (argv, argc);
+  else
+    for (int i = 0; i < argc; i++)
+      err += run_in_memory ? run_file (argv[i]) : compile_file (argv[i]);
 
   return err == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -26,16 +26,332 @@
 
 #include "system.h"
 
+#include "compiler.h"
+#include "evaluator.h"
+#include "stats.h"
 #include "xalloc.h"
 
+/* Replace loops which only add an odd amount to the current cell,
+   like [-] and [+], by setting the cell to zero: the loop ends only
+   when the cell wraps around to zero.  */
+static void
+lower_clear_loops (Command *tokens, size_t length)
+{
+  for (size_t i = 0; i + 2 < length; i++)
+    if (tokens[i].token == T_LABEL
+        && tokens[i + 1].token == T_INCDEC
+        && tokens[i + 1].value % 2 != 0
+        && tokens[i + 2].token == T_JUMP)
+      {
+        tokens[i].token = T_COMMENT;
+        tokens[i + 1] = (Command) { T_SET, 0, 0, 0, 0 };
+        tokens[i + 2].token = T_COMMENT;
+        i += 2;
+      }
+}
+
+/* Replace loops which only move the pointer, like [>] and [<<<<], by
+   scans for the next zero cell with that stride.  */
+static void
+lower_scan_loops (Command *tokens, size_t length)
+{
+  for (size_t i = 0; i + 2 < length; i++)
+    if (tokens[i].token == T_LABEL
+        && tokens[i + 1].token == T_POINTER_INCDEC
+        && tokens[i + 2].token == T_JUMP)
+      {
+        tokens[i].token = T_COMMENT;
+        tokens[i + 1].token = T_SCAN;
+        tokens[i + 2].token = T_COMMENT;
+        i += 2;
+      }
+}
+
+/* Multiplicative inverse of the odd VALUE modulo the cell size.  */
+static i32
+cell_inverse (i32 value)
+{
+  /* Every step of Newton's iteration doubles the number of correct
+     low bits, VALUE itself is right in the low three.  */
+  u32 inverse = value;
+  for (unsigned int bits = 3; bits < CELL_BITS; bits *= 2)
+    inverse *= 2 - (u32) value * inverse;
+  return fold_cell_increment (inverse & ((1u << CELL_BITS) - 1));
+}
+
+typedef struct
+{
+  i64 offset;
+  i64 increment;
+} CellIncrement;
+
+/* Replace balanced loops which only add constants to cells, and add
+   an odd amount DELTA to the current cell, like [->+>++<<], by
+   multiplications.  The body runs CELL * inverse (-DELTA) times, so
+   every other cell gets that many times its increment added, then the
+   current cell becomes zero.  Only innermost loops are lowered.  */
+static void
+lower_multiply_loops (Command *tokens, size_t length)
+{
+  /* Total increment of each cell the body of the loop changes.  */
+  CellIncrement *cells = xnmalloc (length, sizeof (*cells));
+
+  for (size_t i = 0; i < length; i++)
+    {
+      if (tokens[i].token != T_LABEL)
+        continue;
+
+      size_t cells_length = 0;
+      i64 offset = 0;
+      size_t end = i + 1;
+      for (; end < length; end++)
+        {
+          const Command current = tokens[end];
+          if (current.token == T_POINTER_INCDEC)
+            offset += current.value;
+          else if (current.token == T_INCDEC)
+            {
+              size_t k = 0;
+              while (k < cells_length && cells[k].offset != offset)
+                k++;
+              if (k == cells_length)
+                cells[cells_length++] = (CellIncrement) { offset, 0 };
+              cells[k].increment += current.value;
+            }
+          else if (current.token != T_COMMENT)
+            break;
+          if (offset < -INT32_MAX || offset > INT32_MAX)
+            break;
+        }
+
+      if (end == length || tokens[end].token != T_JUMP || offset != 0)
+        /* Not a balanced loop of increments.  */
+        continue;
+
+      i32 delta = 0;
+      for (size_t k = 0; k < cells_length; k++)
+        if (cells[k].offset == 0)
+          delta = fold_cell_increment (cells[k].increment);
+      if (delta % 2 == 0)
+        /* Does not end for every value of the cell.  */
+        continue;
+
+      const i32 count = cell_inverse (-delta);
+      size_t result_length = i;
+      for (size_t k = 0; k < cells_length; k++)
+        {
+          const i32 factor = fold_cell_increment (cells[k].increment * count);
+          if (cells[k].offset != 0 && factor != 0)
+            tokens[result_length++] = (Command) { T_MULADD, factor,
+                                                  cells[k].offset, 0, 0 };
+        }
+      tokens[result_length++] = (Command) { T_SET, 0, 0, 0, 0 };
+      for (; result_length <= end; result_length++)
+        tokens[result_length].token = T_COMMENT;
+
+      i = end;
+    }
+
+  free (cells);
+}
+
+/* Append a move of the pointer by *OFFSET to TOKENS and clear it.  */
+static void
+flush_pointer_move (Command *tokens, size_t *length, i64 *offset)
+{
+  if (*offset != 0)
+    tokens[(*length)++] = (Command) { T_POINTER_INCDEC, *offset, 0, 0, 0 };
+  *offset = 0;
+}
+
+/* Move the pointer only once at the end of each block of commands
+   between loop boundaries and I/O, cell increments, sets and
+   multiplications address their cells by offset from the pointer
+   at the start of the block.  Increments and
+   sets of the same cell next to each other are merged.  Returns the new number
+   of TOKENS, it is never greater than LENGTH.  */
+static size_t
+defer_pointer_moves (Command *tokens, size_t length)
+{
+  size_t result_length = 0;
+  i64 offset = 0;
+
+  for (size_t i = 0; i < length; i++)
+    {
+      Command current = tokens[i];
+      switch (current.token)
+        {
+        case T_COMMENT:
+          continue;
+        case T_POINTER_INCDEC:
+          if (offset + current.value < -INT32_MAX
+              || offset + current.value > INT32_MAX)
+            flush_pointer_move (tokens, &result_length, &offset);
+          offset += current.value;
+          continue;
+        case T_INCDEC:
+        case T_SET:
+        case T_MULADD:
+          if (offset + current.offset < -INT32_MAX
+              || offset + current.offset > INT32_MAX)
+            flush_pointer_move (tokens, &result_length, &offset);
+          current.offset += offset;
+          current.source_offset += offset;
+          if (current.token != T_MULADD
+              && result_length > 0
+              && (tokens[result_length - 1].token == T_INCDEC
+                  || tokens[result_length - 1].token == T_SET)
+              && tokens[result_length - 1].offset == current.offset)
+            {
+              Command *previous = &tokens[result_length - 1];
+              if (current.token == T_SET)
+                /* The set overrides what was done to the cell before.  */
+                *previous = current;
+              else
+                {
+                  previous->value = fold_cell_increment ((i64) previous->value
+                                                         + current.value);
+                  if (previous->token == T_INCDEC && previous->value == 0)
+                    /* Increments cancel each other out.  */
+                    result_length--;
+                }
+              continue;
+            }
+          break;
+        default:
+          /* Loops test, scans and I/O use the cell under the pointer.  */
+          flush_pointer_move (tokens, &result_length, &offset);
+          break;
+        }
+
+      tokens[result_length++] = current;
+    }
+
+  /* The last move of the pointer has no effect.  */
+
+  return result_length;
+}
+
+/* Give SOURCE the state of the program when it has run up to the
+   command at STATE's position.  The commands before it which cannot
+   run again, the ones outside of the loops around it, are removed.  */
+static void
+start_from (ProgramSource *source, const Evaluation *state)
+{
+  size_t first = state->position;
+  for (size_t i = 0; i < state->position; i++)
+    if (source->tokens[i].token == T_LABEL
+        && source->tokens[i].match >= state->position)
+      {
+        /* Outermost loop around the position.  */
+        first = i;
+        break;
+      }
+
+  source->length -= first;
+  memmove (source->tokens, source->tokens + first,
+           source->length * sizeof (*source->tokens));
+  link_labels (source->tokens, source->length);
+  source->start = state->position - first;
+  source->start_pointer = state->pointer;
+
+  source->have_getchar_commands = false;
+  source->have_putchar_commands = false;
+  for (size_t i = 0; i < source->length; i++)
+    if (source->tokens[i].token == T_GETCHAR)
+      source->have_getchar_commands = true;
+    else if (source->tokens[i].token == T_PUTCHAR)
+      source->have_putchar_commands = true;
+
+  /* Cells after the last nonzero one need not be stored.  */
+  size_t tape_length = DATA_ARRAY_SIZE;
+  while (tape_length > 0 && state->tape[tape_length - 1] == 0)
+    tape_length--;
+  source->tape = xmemdup (state->tape, tape_length);
+  source->tape_length = tape_length;
+}
+
+/* Run SOURCE at compile time until its first input, or as long as the
+   step limit allows, and start the program from there with the tape
+   and the output it had.  A program which reads no input and ends
+   within the limit is left with only its output.  A program which gets
+   stuck in a loop doing nothing prints its output and then loops
+   forever.  */
+static void
+evaluate_program (ProgramSource *source)
+{
+  Evaluation state;
+  init_evaluation (&state);
+
+  const EvaluationResult result = evaluate (source, &state,
+                                            EVALUATION_STEP_LIMIT);
+  switch (result)
+    {
+    case EVALUATION_FINISHED:
+    case EVALUATION_INFINITE_LOOP:
+      free (source->tokens);
+      source->tokens = NULL;
+      source->length = 0;
+      source->have_getchar_commands = false;
+      source->have_putchar_commands = false;
+      if (result == EVALUATION_INFINITE_LOOP)
+        {
+          error (0, 0, _("warning: program never ends"));
+          /* +[] */
+          source->tokens = xnmalloc (3, sizeof (*source->tokens));
+          source->tokens[0] = (Command) { T_SET, 1, 0, 0, 0 };
+          source->tokens[1] = (Command) { T_LABEL, 0, 0, 0, 0 };
+          source->tokens[2] = (Command) { T_JUMP, 0, 0, 0, 0 };
+          source->length = 3;
+          link_labels (source->tokens, source->length);
+        }
+      break;
+    case EVALUATION_INPUT:
+    case EVALUATION_STEP_LIMIT_REACHED:
+      if (state.pointer < 0 || state.pointer >= DATA_ARRAY_SIZE)
+        {
+          /* Pointer is out of the array for a moment.  */
+          free_evaluation (&state);
+          return;
+        }
+      start_from (source, &state);
+      break;
+    case EVALUATION_OUT_OF_TAPE:
+    case EVALUATION_RUNNING:
+    default:
+      free_evaluation (&state);
+      return;
+    }
+
+  source->output = state.output;
+  source->output_length = state.output_length;
+  state.output = NULL;
+
+  free_evaluation (&state);
+}
+
+/* Returns the number of commands in TOKENS which are not comments, for
+   the statistics of optimizer passes.  */
+static size_t
+count_commands (const Command *tokens, size_t length)
+{
+  if (stats_format == STATS_NONE)
+    return 0;
+
+  size_t count = 0;
+  for (size_t i = 0; i < length; i++)
+    if (tokens[i].token != T_COMMENT)
+      count++;
+
+  return count;
+}
+
 int
 optimize (const Command *const tokens,
           const size_t tokens_len,
           ProgramSource *out_result,
           const unsigned int level)
 {
-  int err = 0;
-
   Command *input_tokens = xmalloc (tokens_len * sizeof (*input_tokens));
   size_t input_len = tokens_len;
   memcpy (input_tokens, tokens, tokens_len * sizeof (Command));
@@ -46,62 +362,55 @@ optimize (const Command *const tokens,
 
   /* Level 1:
      Remove inactive loops (no +-, before the loop start)
+     Replace clear loops ([-], [+]) by a set of the cell
+     Replace multiply loops ([->++<]) by multiplications
+     Replace scan loops ([>], [<<]) by scans
+     Address cells by offset instead of moving the pointer
      Check if there are no output commands
      Check if there are no input  commands.  */
   if (level >= 1)
     {
-      /* Remove inactive loops.  */
-      const int max_passes = 10;
-      bool finished = false;
-      i8 inactive_loop_index = -1;
-      for (int round = 0; round < max_passes && !finished; round++)
+      /* Remove inactive loops: the cell under the pointer is zero
+         until the first increment or input, so every loop before
+         them is never entered.  */
+      stats_pass_begin ("inactive loops", count_commands (input_tokens, input_len));
+      for (size_t i = 0; i < input_len; i++)
         {
-          for (size_t i = 0; i < input_len; i++)
+          const Token token = input_tokens[i].token;
+          if (token == T_INCDEC || token == T_GETCHAR)
+            /* Not inactive.  */
+            break;
+          else if (token == T_LABEL)
             {
-              const Command current = input_tokens[i];
-              const Token token = current.token;
-              if (token == T_INCDEC || token == T_GETCHAR)
-                {
-                  /* Not inactive.  */
-                  finished = true;
-                  break;
-                }
-              else if (token == T_LABEL)
-                {
-                  inactive_loop_index = current.value;
-                  break;
-                }
-            }
-          bool inside_loop = false;
-          for (size_t i = 0; i < input_len; i++)
-            {
-              const Command current = input_tokens[i];
-              if (current.token == T_LABEL && current.value == inactive_loop_index)
-                inside_loop = true;
-              if (inside_loop)
-                {
-                  input_tokens[i].token = T_COMMENT;
-                  if (current.token == T_JUMP && current.value == inactive_loop_index)
-                    break;
-                }
+              const size_t end = input_tokens[i].match;
+              for (size_t j = i; j <= end; j++)
+                input_tokens[j].token = T_COMMENT;
+              i = end;
             }
         }
+      stats_pass_end (count_commands (input_tokens, input_len));
     }
 
-  /* TODO: Level 2:
-     If no print or input commands, program has no effect
-     => Either remove everything or replace with [] if infinite loop.  */
-  if (level >= 2)
+  /* Turn clear loops into sets, multiply loops into multiplications,
+     scan loops into scans and fold pointer moves into offsets of cell
+     commands.  */
+  if (level >= 1)
     {
-      /* Error: Not implemented.  */
-      err = 103;
-      error (0, 0, _("optimization level %i is not implemented"), level);
-    }
+      stats_pass_begin ("clear loops", count_commands (input_tokens, input_len));
+      lower_clear_loops (input_tokens, input_len);
+      stats_pass_end (count_commands (input_tokens, input_len));
 
-  if (err != 0)
-    {
-      free (input_tokens);
-      return err;
+      stats_pass_begin ("multiply loops", count_commands (input_tokens, input_len));
+      lower_multiply_loops (input_tokens, input_len);
+      stats_pass_end (count_commands (input_tokens, input_len));
+
+      stats_pass_begin ("scan loops", count_commands (input_tokens, input_len));
+      lower_scan_loops (input_tokens, input_len);
+      stats_pass_end (count_commands (input_tokens, input_len));
+
+      stats_pass_begin ("pointer moves", count_commands (input_tokens, input_len));
+      input_len = defer_pointer_moves (input_tokens, input_len);
+      stats_pass_end (count_commands (input_tokens, input_len));
     }
 
   size_t input_len_without_comments = input_len;
@@ -128,15 +437,46 @@ optimize (const Command *const tokens,
         have_putchar_commands = true;
     }
 
+  link_labels (out_result->tokens, length);
+
   out_result->length = length;
   out_result->have_putchar_commands = have_putchar_commands;
   out_result->have_getchar_commands = have_getchar_commands;
+  out_result->output = NULL;
+  out_result->output_length = 0;
+  out_result->tape = NULL;
+  out_result->tape_length = 0;
+  out_result->start_pointer = 0;
+  out_result->start = 0;
 
   free (input_tokens);
 
+  /* Level 2:
+     Run the program at compile time up to its first input.  */
+  if (level >= 2)
+    {
+      stats_pass_begin ("evaluation", out_result->length);
+      evaluate_program (out_result);
+      stats_pass_end (out_result->length);
+    }
+
   return 0;
 }
 
+void
+free_program_source (ProgramSource *source)
+{
+  free (source->tokens);
+  free (source->output);
+  free (source->tape);
+  source->tokens = NULL;
+  source->length = 0;
+  source->output = NULL;
+  source->output_length = 0;
+  source->tape = NULL;
+  source->tape_length = 0;
+}
+
 int
 tokenize_and_optimize (const char *const source,
                        const size_t source_len,
@@ -145,14 +485,22 @@ tokenize_and_optimize (const char *const source,
 {
   out_result->tokens = NULL;
   out_result->length = 0;
+  out_result->output = NULL;
+  out_result->output_length = 0;
+  out_result->tape = NULL;
+  out_result->tape_length = 0;
 
   Command *tokenized_source;
   size_t tokenized_source_length = 0;
+  stats_begin (PHASE_TOKENIZE);
   int err = tokenize (source, source_len, &tokenized_source, &tokenized_source_length);
+  stats_end (PHASE_TOKENIZE);
   if (err != 0)
     return err;
 
+  stats_begin (PHASE_OPTIMIZE);
   err = optimize (tokenized_source, tokenized_source_length, out_result, level);
+  stats_end (PHASE_OPTIMIZE);
   free (tokenized_source);
 
   return err;
@@ -28,6 +28,10 @@ extern int optimize (const Command *const tokens,
                      const unsigned int level)
   __nonnull ((1, 3));
 
+/* Free the result of optimize ().  */
+extern void free_program_source (ProgramSource *source)
+  __nonnull ((1));
+
 extern int tokenize_and_optimize (const char *const source,
                                   const size_t source_len,
                                   ProgramSource *out_result,
@@ -0,0 +1,185 @@
+/*  profile.c
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <config.h>
+
+#include "profile.h"
+
+#include <error.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system.h"
+
+#include "read-file.h"
+#include "xalloc.h"
+
+/* Counters of the loops of a profiled program.  */
+typedef struct
+{
+  LoopCounters *loops;
+  size_t length;
+} Profile;
+
+/* Reads the profile FILENAME.  Returns false after reporting an error
+   if it cannot be read or is not a profile.  */
+static bool
+read_profile (const char *filename, Profile *profile)
+{
+  profile->loops = NULL;
+  profile->length = 0;
+
+  size_t length;
+  char *data = read_file (filename, RF_BINARY, &length);
+  if (data == NULL)
+    {
+      error (0, errno, "%s", quotef (filename));
+      return false;
+    }
+
+  const size_t header_length = PROFILE_MAGIC_LENGTH + sizeof (u64);
+  u64 count = 0;
+  if (length >= header_length)
+    memcpy (&count, data + PROFILE_MAGIC_LENGTH, sizeof (count));
+
+  if (length < header_length
+      || memcmp (data, PROFILE_MAGIC, PROFILE_MAGIC_LENGTH) != 0
+      || (length - header_length) % sizeof (LoopCounters) != 0
+      || (length - header_length) / sizeof (LoopCounters) != count)
+    {
+      error (0, 0, _("%s: not a profile"), quotef (filename));
+      free (data);
+      return false;
+    }
+
+  profile->length = count;
+  profile->loops = xnmalloc (count, sizeof (*profile->loops));
+  memcpy (profile->loops, data + header_length,
+          count * sizeof (*profile->loops));
+  free (data);
+
+  return true;
+}
+
+/* Position of a '[' in the source.  */
+typedef struct
+{
+  size_t offset;
+  size_t line;
+  size_t column;
+} LoopPosition;
+
+/* Orders loops by iterations, the most first, then by position.  */
+static int
+compare_iterations (const void *a, const void *b)
+{
+  const LoopCounters *x = a;
+  const LoopCounters *y = b;
+
+  if (x->iterations != y->iterations)
+    return x->iterations < y->iterations ? 1 : -1;
+  return (x->loop > y->loop) - (x->loop < y->loop);
+}
+
+/* Prints PROFILE of the program SOURCE named FILENAME to STREAM.  */
+static bool
+print_profile (FILE *stream, const Profile *profile, const char *filename,
+               const char *source, size_t source_len)
+{
+  /* Position of every '[' of the source, the loops are numbered in
+     the same order by the tokenizer.  */
+  LoopPosition *positions = NULL;
+  size_t positions_alloc = 0;
+  size_t positions_count = 0;
+  size_t line = 1;
+  size_t column = 1;
+  for (size_t i = 0; i < source_len; i++)
+    {
+      if (source[i] == '[')
+        {
+          if (positions_count == positions_alloc)
+            positions = x2nrealloc (positions, &positions_alloc,
+                                    sizeof (*positions));
+          positions[positions_count++] = (LoopPosition) { i, line, column };
+        }
+
+      if (source[i] == '\n')
+        {
+          line++;
+          column = 1;
+        }
+      else
+        column++;
+    }
+
+  for (size_t i = 0; i < profile->length; i++)
+    if (profile->loops[i].loop >= positions_count)
+      {
+        error (0, 0, _("the profile does not match %s"), quotef (filename));
+        free (positions);
+        return false;
+      }
+
+  LoopCounters *loops = xnmalloc (profile->length, sizeof (*loops));
+  memcpy (loops, profile->loops, profile->length * sizeof (*loops));
+  qsort (loops, profile->length, sizeof (*loops), compare_iterations);
+
+  fprintf (stream, _("Loops of %s, the hottest first:\n"), filename);
+  fprintf (stream, "  %12s %10s %20s %20s %12s\n", _("line:column"),
+           _("offset"), _("entries"), _("iterations"), _("per entry"));
+  for (size_t i = 0; i < profile->length; i++)
+    {
+      const LoopPosition *loop = &positions[loops[i].loop];
+      char position[64];
+      snprintf (position, sizeof (position), "%zu:%zu",
+                loop->line, loop->column);
+      fprintf (stream, "  %12s %10zu %20" PRIu64 " %20" PRIu64 " %12.1f\n",
+               position, loop->offset, loops[i].entries, loops[i].iterations,
+               loops[i].entries != 0
+               ? (double) loops[i].iterations / loops[i].entries : 0.0);
+    }
+
+  free (loops);
+  free (positions);
+
+  return true;
+}
+
+bool
+report_profile (FILE *stream, const char *profile_name, const char *filename)
+{
+  Profile profile;
+  if (!read_profile (profile_name, &profile))
+    return false;
+
+  size_t source_len;
+  char *source = read_file (filename, RF_BINARY, &source_len);
+  if (source == NULL)
+    {
+      error (0, errno, "%s", quotef (filename));
+      free (profile.loops);
+      return false;
+    }
+
+  bool printed = print_profile (stream, &profile, filename,
+                                source, source_len);
+  free (source);
+  free (profile.loops);
+
+  return printed;
+}
@@ -0,0 +1,49 @@
+/*  profile.h
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _PROFILE_H
+#define _PROFILE_H 1
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "system.h"
+
+/* A profile written by a program compiled with -fprofile-generate
+   starts with this magic and the number of loops, followed by the
+   counters of every loop which was compiled to a loop.  */
+#define PROFILE_MAGIC "BFCPROF1"
+#define PROFILE_MAGIC_LENGTH (sizeof (PROFILE_MAGIC) - 1)
+
+typedef struct
+{
+  /* Index of the loop, N for the N-th '[' of the source.  */
+  u64 loop;
+  /* Times the loop was reached and times its body ran.  */
+  u64 entries;
+  u64 iterations;
+} LoopCounters;
+
+/* Prints the counters of the profile PROFILE_NAME, the hottest loop
+   first, with the position of every loop in FILENAME, the source code
+   of the profiled program.  Returns false after reporting an error if
+   a file cannot be read or the profile does not match the source.  */
+extern bool report_profile (FILE *stream, const char *profile_name,
+                            const char *filename)
+  __nonnull ((1, 2, 3));
+
+#endif /* _PROFILE_H */
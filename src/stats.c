@@ -0,0 +1,220 @@
+/*  stats.c
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <config.h>
+
+#include "stats.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "system.h"
+
+StatsFormat stats_format = STATS_NONE;
+
+/* Resources used up to some point.  */
+typedef struct
+{
+  double wall;
+  double cpu;
+  /* Peak resident set size in KiB.  */
+  long peak;
+} Usage;
+
+typedef struct
+{
+  const char *name;
+  /* Run by a child process.  */
+  bool external;
+  bool measured;
+  Usage total;
+  Usage start;
+} PhaseStats;
+
+static PhaseStats phases[PHASE_MAX] =
+{
+  [PHASE_READ]     = { "read",     false },
+  [PHASE_TOKENIZE] = { "tokenize", false },
+  [PHASE_OPTIMIZE] = { "optimize", false },
+  [PHASE_GENERATE] = { "generate", false },
+  [PHASE_WRITE]    = { "write",    false },
+  [PHASE_ASSEMBLE] = { "as",       true  },
+  [PHASE_LINK]     = { "ld",       true  },
+  [PHASE_RUN]      = { "run",      false }
+};
+
+typedef struct
+{
+  const char *name;
+  size_t commands_before;
+  size_t commands_after;
+  Usage total;
+} PassStats;
+
+/* Passes of the optimizer in the order they ran.  */
+#define MAX_PASSES 16
+static PassStats passes[MAX_PASSES];
+static size_t passes_length = 0;
+static Usage pass_start;
+
+static double
+seconds (const struct timeval *time)
+{
+  return time->tv_sec + time->tv_usec / 1e6;
+}
+
+static Usage
+current_usage (bool external)
+{
+  struct timespec now;
+  struct rusage rusage;
+  Usage result;
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  getrusage (external ? RUSAGE_CHILDREN : RUSAGE_SELF, &rusage);
+  result.wall = now.tv_sec + now.tv_nsec / 1e9;
+  result.cpu = seconds (&rusage.ru_utime) + seconds (&rusage.ru_stime);
+  result.peak = rusage.ru_maxrss;
+
+  return result;
+}
+
+static void
+accumulate (Usage *total, const Usage *start, const Usage *end)
+{
+  total->wall += end->wall - start->wall;
+  total->cpu += end->cpu - start->cpu;
+  if (total->peak < end->peak)
+    total->peak = end->peak;
+}
+
+void
+stats_begin (Phase phase)
+{
+  if (stats_format == STATS_NONE)
+    return;
+
+  phases[phase].start = current_usage (phases[phase].external);
+}
+
+void
+stats_end (Phase phase)
+{
+  if (stats_format == STATS_NONE)
+    return;
+
+  const Usage end = current_usage (phases[phase].external);
+  accumulate (&phases[phase].total, &phases[phase].start, &end);
+  phases[phase].measured = true;
+}
+
+void
+stats_pass_begin (const char *name, size_t commands)
+{
+  if (stats_format == STATS_NONE || passes_length == MAX_PASSES)
+    return;
+
+  memset (&passes[passes_length], 0, sizeof (passes[passes_length]));
+  passes[passes_length].name = name;
+  passes[passes_length].commands_before = commands;
+  pass_start = current_usage (false);
+}
+
+void
+stats_pass_end (size_t commands)
+{
+  if (stats_format == STATS_NONE || passes_length == MAX_PASSES)
+    return;
+
+  const Usage end = current_usage (false);
+  accumulate (&passes[passes_length].total, &pass_start, &end);
+  passes[passes_length].commands_after = commands;
+  passes_length++;
+}
+
+/* Prints S as a JSON string.  */
+static void
+print_json_string (FILE *stream, const char *s)
+{
+  putc ('"', stream);
+  for (; *s != '\0'; s++)
+    if (*s == '"' || *s == '\\')
+      fprintf (stream, "\\%c", *s);
+    else if ((unsigned char) *s < ' ')
+      fprintf (stream, "\\u%04x", (unsigned char) *s);
+    else
+      putc (*s, stream);
+  putc ('"', stream);
+}
+
+void
+print_stats (FILE *stream, const char *filename)
+{
+  if (stats_format == STATS_JSON)
+    {
+      fputs ("{\"file\": ", stream);
+      print_json_string (stream, filename);
+      fputs (", \"phases\": [", stream);
+      const char *separator = "";
+      for (size_t i = 0; i < PHASE_MAX; i++)
+        if (phases[i].measured)
+          {
+            fprintf (stream, "%s{\"name\": \"%s\", \"wall\": %.6f, "
+                     "\"cpu\": %.6f, \"peak_kib\": %ld}",
+                     separator, phases[i].name, phases[i].total.wall,
+                     phases[i].total.cpu, phases[i].total.peak);
+            separator = ", ";
+          }
+      fputs ("], \"passes\": [", stream);
+      for (size_t i = 0; i < passes_length; i++)
+        fprintf (stream, "%s{\"name\": \"%s\", \"commands_before\": %zu, "
+                 "\"commands_after\": %zu, \"wall\": %.6f, \"cpu\": %.6f}",
+                 i == 0 ? "" : ", ", passes[i].name,
+                 passes[i].commands_before, passes[i].commands_after,
+                 passes[i].total.wall, passes[i].total.cpu);
+      fputs ("]}\n", stream);
+    }
+  else if (stats_format == STATS_TEXT)
+    {
+      fprintf (stream, _("Statistics of %s:\n"), filename);
+      fprintf (stream, "  %-16s %12s %12s %12s\n",
+               _("phase"), _("wall (s)"), _("cpu (s)"), _("peak (KiB)"));
+      for (size_t i = 0; i < PHASE_MAX; i++)
+        if (phases[i].measured)
+          fprintf (stream, "  %-16s %12.6f %12.6f %12ld\n",
+                   phases[i].name, phases[i].total.wall,
+                   phases[i].total.cpu, phases[i].total.peak);
+      if (passes_length != 0)
+        {
+          fprintf (stream, "  %-16s %12s %12s %12s\n",
+                   _("pass"), _("commands"), _("after"), _("wall (s)"));
+          for (size_t i = 0; i < passes_length; i++)
+            fprintf (stream, "  %-16s %12zu %12zu %12.6f\n",
+                     passes[i].name, passes[i].commands_before,
+                     passes[i].commands_after, passes[i].total.wall);
+        }
+    }
+
+  for (size_t i = 0; i < PHASE_MAX; i++)
+    {
+      phases[i].measured = false;
+      memset (&phases[i].total, 0, sizeof (phases[i].total));
+    }
+  passes_length = 0;
+}
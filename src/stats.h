@@ -0,0 +1,66 @@
+/*  stats.h
+    Copyright (C) 2019 Sergey Sushilin
+    This file is part of the BrainFuck Compiler
+
+    BrainFuck Compiler is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _STATS_H
+#define _STATS_H 1
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "system.h"
+
+/* Phases of a compilation measured by --stats.  */
+typedef enum
+{
+  PHASE_READ,
+  PHASE_TOKENIZE,
+  PHASE_OPTIMIZE,
+  PHASE_GENERATE,
+  PHASE_WRITE,
+  PHASE_ASSEMBLE,
+  PHASE_LINK,
+  PHASE_RUN,
+  PHASE_MAX
+} Phase;
+
+typedef enum
+{
+  STATS_NONE,
+  STATS_TEXT,
+  STATS_JSON
+} StatsFormat;
+
+/* How statistics are printed, STATS_NONE if they are not collected.  */
+extern StatsFormat stats_format;
+
+/* Start and stop measuring wall time, CPU time and peak memory of
+   PHASE.  Phases run by external tools are measured from their child
+   processes.  */
+extern void stats_begin (Phase phase);
+extern void stats_end (Phase phase);
+
+/* Start and stop measuring the optimizer pass NAME, which turns
+   COMMANDS commands into the number given to stats_pass_end ().  */
+extern void stats_pass_begin (const char *name, size_t commands);
+extern void stats_pass_end (size_t commands);
+
+/* Prints the statistics of compiling FILENAME to STREAM in
+   stats_format and forgets them.  */
+extern void print_stats (FILE *stream, const char *filename)
+  __nonnull ((1, 2));
+
+#endif /* _STATS_H */
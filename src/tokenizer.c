@@ -19,7 +19,9 @@
 
 #include "tokenizer.h"
 
+#include <assert.h>
 #include <error.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -27,9 +29,24 @@
 
 #include "system.h"
 
+#include "classify.h"
 #include "die.h"
 #include "xalloc.h"
 
+i32
+fold_cell_increment (i64 value)
+{
+  const i64 cell_size = INT64_C (1) << CELL_BITS;
+
+  value %= cell_size;
+  if (value >= cell_size / 2)
+    value -= cell_size;
+  else if (value < -cell_size / 2)
+    value += cell_size;
+
+  return value;
+}
+
 static void
 append_to_array (const Command cmd,
                  Command **out_result,
@@ -44,94 +61,104 @@ tokenize (const char *const source,
           Command **out_result,
           size_t *out_result_len)
 {
-  /* Count [ and ] commands.  Difference should be 0 at the end of the program, so
-     that all jumps have a matching label.  */
-  size_t opening_label_count = 0;
-  size_t closing_label_count = 0;
+  /* Positions of the labels which are not closed yet.  Every jump
+     is matched against the top of the stack, so the whole program
+     is processed in a single pass.  */
+  size_t *open_labels = NULL;
+  size_t open_labels_alloc = 0;
+  size_t open_labels_count = 0;
+
+  /* Number of labels seen so far, it is also the index of the next one.  */
+  i32 label_count = 0;
 
   /* Initialize final result */
   *out_result = NULL;
   *out_result_len = 0;
-  Command *result = xmalloc (source_len * sizeof (*result));
+  Command *result = xnmalloc (source_len, sizeof (*result));
   size_t result_len = 0;
 
-  /* Command that is currently being constructed.  */
-  Command command = { T_COMMENT, 0 };
-
   int errorcode = 0;
   for (size_t i = 0; i < source_len; i++)
     {
-      unsigned char c_current = source[i];
-      unsigned char c_next = source[i + 1];
+      const Token current = parse_token (source[i]);
 
-      Token current = parse_token (c_current);
-      Token next = parse_token (c_next);
-
-      command.token = current;
+      /* Command that is currently being constructed.  */
+      Command command = { current, 0, 0, 0, 0 };
 
       /* Set value for this command:
-         Data increment and pointer increment are added to previous symbol.
-         Labels and jumps need a number.
+         Data increment and pointer increment are summed over the run of
+         the same commands.  Labels and jumps need a number.
          Read and print need nothing.  */
-      if (current == T_INCDEC || current == T_POINTER_INCDEC)
-        command.value += parse_value (c_current);
-      else if (current == T_LABEL)
-        command.value = opening_label_count++;
-      else if (current == T_JUMP)
+      switch (current)
         {
-          closing_label_count++;
-          if (closing_label_count > opening_label_count)
+        case T_INCDEC:
+        case T_POINTER_INCDEC:
+          {
+            i64 value;
+            i += fold_run (source + i, source_len - i, &value) - 1;
+            if (current == T_INCDEC)
+              value = fold_cell_increment (value);
+            else if (value < -INT32_MAX || value > INT32_MAX)
+              {
+                /* Error: Pointer moves far beyond the data array.  */
+                errorcode = 104;
+                error (0, 0, _("pointer increment %" PRIi64 " is too large"), value);
+                break;
+              }
+            if (value == 0)
+              /* Command has no effect.  */
+              continue;
+            command.value = value;
+          }
+          break;
+        case T_LABEL:
+          if (label_count == INT32_MAX)
             {
-              /* Error: Label mismatch.  */
+              /* Error: Too many loops to number them.  */
               errorcode = 102;
+              error (0, 0, _("too many loops"));
               break;
             }
-
-          /* Traverse final result backwards to find the correct label.  */
-          i32 correct_label = -1;
-          ptrdiff_t open_labels_to_skip = 0;
-
-          size_t kk = result_len - 1;
-          do
-            {
-              if (result[kk].token == T_JUMP)
-                open_labels_to_skip++;
-              else if (result[kk].token == T_LABEL && open_labels_to_skip-- == 0)
-                {
-                  correct_label = result[kk].value;
-                  break;
-                }
-            }
-          while (kk-- != 0);
-
-          if (correct_label < 0)
+          if (open_labels_count == open_labels_alloc)
+            open_labels = x2nrealloc (open_labels, &open_labels_alloc,
+                                      sizeof (*open_labels));
+          open_labels[open_labels_count++] = result_len;
+          command.value = label_count++;
+          break;
+        case T_JUMP:
+          if (open_labels_count == 0)
             {
+              /* Error: Label mismatch.  */
               errorcode = 102;
               error (0, 0, _("label mismatch"));
               break;
             }
-          command.value = correct_label;
+          command.match = open_labels[--open_labels_count];
+          command.value = result[command.match].value;
+          result[command.match].match = result_len;
+          break;
+        case T_COMMENT:
+          continue;
+        default:
+          break;
         }
 
-      /* Expecting new command: Push previous command to the final result and make a new one.  */
-      if (current != next || (current != T_INCDEC && current != T_POINTER_INCDEC))
-        {
-          if (command.token != T_COMMENT)
-            append_to_array (command, &result, &result_len);
-          command.token = current;
-          command.value = 0;
-        }
+      if (errorcode != 0)
+        break;
+
+      append_to_array (command, &result, &result_len);
     }
-  if (errorcode == 0)
+
+  if (errorcode == 0 && open_labels_count != 0)
     {
-      if (opening_label_count != closing_label_count)
-        {
-          /* Error: Label mismatch.  */
-          errorcode = 102;
-          error (0, 0, _("label mismatch"));
-        }
+      /* Error: Label mismatch.  */
+      errorcode = 102;
+      error (0, 0, _("label mismatch"));
     }
-  else
+
+  free (open_labels);
+
+  if (errorcode != 0)
     {
       free (result);
       return errorcode;
@@ -143,3 +170,30 @@ tokenize (const char *const source,
 
   return 0;
 }
+
+void
+link_labels (Command *tokens, size_t length)
+{
+  size_t *open_labels = NULL;
+  size_t open_labels_alloc = 0;
+  size_t open_labels_count = 0;
+
+  for (size_t i = 0; i < length; i++)
+    if (tokens[i].token == T_LABEL)
+      {
+        if (open_labels_count == open_labels_alloc)
+          open_labels = x2nrealloc (open_labels, &open_labels_alloc,
+                                    sizeof (*open_labels));
+        open_labels[open_labels_count++] = i;
+      }
+    else if (tokens[i].token == T_JUMP)
+      {
+        assert (open_labels_count != 0);
+        size_t label = open_labels[--open_labels_count];
+        tokens[label].match = i;
+        tokens[i].match = label;
+      }
+
+  assert (open_labels_count == 0);
+  free (open_labels);
+}
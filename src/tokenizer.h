@@ -31,6 +31,9 @@
  * jump to label, index
  * read input
  * print output
+ * set cell, value (made by the optimizer)
+ * add cell multiplied by a factor to another cell, factor (made by the optimizer)
+ * move pointer to the next zero cell, stride (made by the optimizer)
  */
 typedef enum
 {
@@ -41,14 +44,32 @@ typedef enum
   T_JUMP,
   T_GETCHAR,
   T_PUTCHAR,
+  T_SET,
+  T_MULADD,
+  T_SCAN,
   T_MAX
 } Token;
 
+/* Width of a cell of the data array in bits.  Increments of a cell are
+   folded modulo its size.  */
+#define CELL_BITS 8
+
 /* Single Brainfuck command after parsing.  */
 typedef struct
 {
-  Token token:3;
-  i8 value;
+  Token token;
+  /* Amount for increments (a cell increment is folded into
+     [-2^(CELL_BITS-1), 2^(CELL_BITS-1))), value to set the cell to and
+     factor of a multiplication, folded the same way, stride of a scan,
+     index of the loop for labels and jumps.  */
+  i32 value;
+  /* Offset from the tape pointer of the cell an increment, a set or
+     a multiplication changes.  */
+  i32 offset;
+  /* Offset from the tape pointer of the cell a multiplication reads.  */
+  i32 source_offset;
+  /* Position of the matching jump for labels and vice versa.  */
+  size_t match;
 } Command;
 
 /* Complete Brainfuck program after parsing and optimizing.  */
@@ -56,6 +77,17 @@ typedef struct
 {
   Command *tokens;
   size_t length;
+  /* Output which is known at compile time, it is printed before the
+     program runs.  */
+  char *output;
+  size_t output_length;
+  /* Initial contents of the first TAPE_LENGTH cells, the rest are zero.  */
+  u8 *tape;
+  size_t tape_length;
+  /* Initial position of the pointer in the array and index of the
+     first command to run.  */
+  size_t start_pointer;
+  size_t start;
   bool have_getchar_commands:1;
   bool have_putchar_commands:1;
 } ProgramSource;
@@ -66,6 +98,13 @@ extern int tokenize (const char *const source,
                      size_t *out_result_len)
   __nonnull ((1, 3, 4));
 
+/* Reduce increment of a cell modulo the cell size.  */
+extern i32 fold_cell_increment (i64 value);
+
+/* Recompute MATCH of every label and jump after the tokens were moved.  */
+extern void link_labels (Command *tokens, size_t length)
+  __nonnull ((1));
+
 verify (CHAR_BIT == 8 && T_COMMENT == 0);
 
 static const Token token_table[0400] =
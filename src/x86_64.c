@@ -15,52 +15,175 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
-static const char init_variables[] =
+const char target_name[] = "x86_64";
+
+/* The array starts with the cells known at compile time, if any.  */
+static const char init_array[] =
 ".section .data\n"
-"array:\n"
+"array:\n";
+static const char init_variables[] =
+"        .zero       %u\n"
+"        .balign     8\n"
+"output_length:\n"
+"        .quad       0\n"
+"input_position:\n"
+"        .quad       0\n"
+"input_length:\n"
+"        .quad       0\n"
+"interactive:\n"
+"        .quad       0\n"
+"termios:\n"
+"        .zero       64\n"
+"input:\n"
 "        .zero       %u\n"
-"buffer:\n"
-"        .byte       0\n";
+"output:\n"
+"        .zero       %u\n";
+
+static const char data_bytes[] =
+"        .byte       %s\n";
+
+/* Output known at compile time, see write_constant_output.  */
+static const char constant_output_begin[] =
+".section .rodata\n"
+"constant_output:\n";
 
 static const char init_section_text[] =
 ".section .text\n"
 ".globl _start\n"
 "\n";
 
+/* Output is collected in the buffer OUTPUT and written when it is full,
+   before reading input and at exit.  */
+static const char flush_body[] =
+".type flush,@function\n"
+"flush:\n"
+"        pushq       %%rax\n"
+"        leaq        output(%%rip),%%rsi\n"
+"        movq        output_length(%%rip),%%rdx\n"
+".Lflush_write:\n"
+"        testq       %%rdx,%%rdx\n"
+"        je          .Lflush_done\n"
+"        movl        $1,%%eax\n"
+"        movl        $1,%%edi\n"
+"        syscall\n"
+"        testq       %%rax,%%rax\n"
+"        jle         .Lflush_done\n"
+"        addq        %%rax,%%rsi\n"
+"        subq        %%rax,%%rdx\n"
+"        jmp         .Lflush_write\n"
+".Lflush_done:\n"
+"        movq        $0,output_length(%%rip)\n"
+"        popq        %%rax\n"
+"        ret\n"
+"\n";
+
+/* Input is read in blocks into the buffer INPUT, which is refilled
+   when it is empty.  At the end of input the cell is set according to
+   the EOF policy.  */
 static const char getchar_body[] =
 ".type getchar,@function\n"
 "getchar:\n"
+"        call        flush\n"
+"        movq        input_position(%%rip),%%rcx\n"
+"        movq        input_length(%%rip),%%rdx\n"
+"        cmpq        %%rdx,%%rcx\n"
+"        jb          .Lgetchar_read\n"
 "        pushq       %%rax\n"
-"        xorq        %%rax,%%rax\n"
-"        xorq        %%rdi,%%rdi\n"
-"        movq        $buffer,%%rsi\n"
-"        movq        $1,%%rdx\n"
+"        xorl        %%eax,%%eax\n"
+"        xorl        %%edi,%%edi\n"
+"        leaq        input(%%rip),%%rsi\n"
+"        movl        $%u,%%edx\n"
 "        syscall\n"
+"        movq        %%rax,%%rdx\n"
 "        popq        %%rax\n"
-"        movb        (buffer),%%cl\n"
-"        movb        %%cl,(%%rax)\n"
+"        testq       %%rdx,%%rdx\n"
+"        jle         .Lgetchar_eof\n"
+"        movq        %%rdx,input_length(%%rip)\n"
+"        xorl        %%ecx,%%ecx\n"
+".Lgetchar_read:\n"
+"        leaq        input(%%rip),%%rdx\n"
+"        addq        %%rcx,%%rdx\n"
+"        movb        (%%rdx),%%bl\n"
+"        movb        %%bl,(%%rax)\n"
+"        addq        $1,%%rcx\n"
+"        movq        %%rcx,input_position(%%rip)\n"
+"        ret\n"
+".Lgetchar_eof:\n";
+
+static const char eof_zero[] =
+"        movb        $0,(%%rax)\n";
+static const char eof_minus_one[] =
+"        movb        $255,(%%rax)\n";
+
+static const char getchar_fini[] =
 "        ret\n"
 "\n";
 
 static const char putchar_body[] =
 ".type putchar,@function\n"
 "putchar:\n"
-"        pushq       %%rax\n"
+"        movq        output_length(%%rip),%%rcx\n"
 "        movb        (%%rax),%%bl\n"
-"        movb        %%bl,(buffer)\n"
-"        movq        $1,%%rax\n"
-"        movq        $1,%%rdi\n"
-"        movq        $buffer,%%rsi\n"
-"        movq        $1,%%rdx\n"
-"        syscall\n"
-"        popq        %%rax\n"
+"        leaq        output(%%rip),%%rdx\n"
+"        addq        %%rcx,%%rdx\n"
+"        movb        %%bl,(%%rdx)\n"
+"        addq        $1,%%rcx\n"
+"        movq        %%rcx,output_length(%%rip)\n"
+"        cmpq        $%u,%%rcx\n"
+"        je          flush\n"
+"        cmpb        $10,(%%rdx)\n"
+"        jne         .Lputchar_done\n"
+"        cmpb        $0,interactive(%%rip)\n"
+"        jne         flush\n"
+".Lputchar_done:\n"
 "        ret\n"
 "\n";
 
 static const char start_init[] =
 ".type _start,@function\n"
-"_start:\n"
-"        movq        $array,%%rax\n";
+"_start:\n";
+
+/* Output to a terminal is flushed at every newline, so the program
+   talks to the user a line at a time.  */
+static const char detect_terminal[] =
+"        movl        $16,%%eax\n"
+"        movl        $1,%%edi\n"
+"        movl        $0x5401,%%esi\n"
+"        leaq        termios(%%rip),%%rdx\n"
+"        syscall\n"
+"        testq       %%rax,%%rax\n"
+"        jne         .Lnot_terminal\n"
+"        movb        $1,interactive(%%rip)\n"
+".Lnot_terminal:\n";
+
+/* Output known at compile time is written at once before the program
+   starts.  */
+static const char write_constant_output[] =
+"        leaq        constant_output(%%rip),%%rsi\n"
+"        movl        $%zu,%%edx\n"
+".Lconstant_output_write:\n"
+"        movl        $1,%%eax\n"
+"        movl        $1,%%edi\n"
+"        syscall\n"
+"        testq       %%rax,%%rax\n"
+"        jle         .Lconstant_output_done\n"
+"        addq        %%rax,%%rsi\n"
+"        subq        %%rax,%%rdx\n"
+"        jne         .Lconstant_output_write\n"
+".Lconstant_output_done:\n";
+
+static const char init_pointer[] =
+"        movq        $array+%zu,%%rax\n";
+
+/* Program which was run up to some command at compile time continues
+   from there.  */
+static const char jump_to_start[] =
+"        jmp         .Lresume\n";
+static const char start_label[] =
+".Lresume:\n";
+
+static const char call_flush[] =
+"        call        flush\n";
 
 static const char start_fini[] =
 "\n"
@@ -69,16 +192,103 @@ static const char start_fini[] =
 "        syscall\n";
 
 static const char increment_current_value[] =
-"        movb        $%i,%%bl\n"
-"        addb        %%bl,(%%rax)\n";
+"        addb        $%i,%i(%%rax)\n";
 static const char decrement_current_value[] =
-"        movb        $%i,%%bl\n"
-"        subb        %%bl,(%%rax)\n";
+"        subb        $%i,%i(%%rax)\n";
+static const char set_current_value[] =
+"        movb        $%i,%i(%%rax)\n";
+/* The cell at the source offset multiplied by a factor is added to
+   the cell at the offset.  */
+static const char load_source_value[] =
+"        movzbl      %i(%%rax),%%ecx\n";
+static const char multiply_source_value[] =
+"        imull       $%i,%%ecx,%%ecx\n";
+static const char add_product[] =
+"        addb        %%cl,%i(%%rax)\n";
+static const char subtract_product[] =
+"        subb        %%cl,%i(%%rax)\n";
 static const char increment_current_pointer[] =
 "        addq        $%i,%%rax\n";
 static const char decrement_current_pointer[] =
 "        subq        $%i,%%rax\n";
 
+/* Scans for a zero cell with a stride which divides 16 look at 16
+   cells at once while they stay inside the array: the mask keeps the
+   bits of pcmpeqb result for the cells of the stride.  The rest of
+   the scan is done a cell at a time.  */
+#define HAVE_VECTOR_SCAN 1
+
+static u32
+scan_mask (i32 stride)
+{
+  const i32 distance = stride < 0 ? -stride : stride;
+  u32 mask;
+
+  switch (distance)
+    {
+    case 1:
+      mask = 0xffff;
+      break;
+    case 2:
+      mask = 0x5555;
+      break;
+    case 4:
+      mask = 0x1111;
+      break;
+    case 8:
+      mask = 0x0101;
+      break;
+    default:
+      return 0;
+    }
+
+  /* Backward scans look at the cells below the pointer.  */
+  return stride < 0 ? mask << (distance - 1) : mask;
+}
+
+static const char scan_right_vector[] =
+"        pxor        %%xmm0,%%xmm0\n"
+"        leaq        array+%u(%%rip),%%rdx\n"
+".LSV%zu:\n"
+"        cmpq        %%rdx,%%rax\n"
+"        ja          .LSS%zu\n"
+"        movdqu      (%%rax),%%xmm1\n"
+"        pcmpeqb     %%xmm0,%%xmm1\n"
+"        pmovmskb    %%xmm1,%%ecx\n"
+"        andl        $%#x,%%ecx\n"
+"        jne         .LSF%zu\n"
+"        addq        $16,%%rax\n"
+"        jmp         .LSV%zu\n"
+".LSF%zu:\n"
+"        bsfl        %%ecx,%%ecx\n"
+"        addq        %%rcx,%%rax\n"
+"        jmp         .LSD%zu\n";
+static const char scan_left_vector[] =
+"        pxor        %%xmm0,%%xmm0\n"
+"        leaq        array+15(%%rip),%%rdx\n"
+".LSV%zu:\n"
+"        cmpq        %%rdx,%%rax\n"
+"        jb          .LSS%zu\n"
+"        movdqu      -15(%%rax),%%xmm1\n"
+"        pcmpeqb     %%xmm0,%%xmm1\n"
+"        pmovmskb    %%xmm1,%%ecx\n"
+"        andl        $%#x,%%ecx\n"
+"        jne         .LSF%zu\n"
+"        subq        $16,%%rax\n"
+"        jmp         .LSV%zu\n"
+".LSF%zu:\n"
+"        bsrl        %%ecx,%%ecx\n"
+"        subq        $15,%%rax\n"
+"        addq        %%rcx,%%rax\n"
+"        jmp         .LSD%zu\n";
+static const char scan_scalar[] =
+".LSS%zu:\n"
+"        cmpb        $0,(%%rax)\n"
+"        je          .LSD%zu\n"
+"        addq        $%i,%%rax\n"
+"        jmp         .LSS%zu\n"
+".LSD%zu:\n";
+
 static const char label_begin[] =
 "\n"
 ".LB%i:\n"
@@ -90,17 +300,334 @@ static const char label_end[] =
 "        cmpb        $0,(%%rax)\n"
 "        jne         .LB%i\n";
 
+/* Profiled programs count how many times every loop is reached and
+   how many times its body runs in the counters section, and write the
+   section to the profile file at exit.  */
+static const char profile_begin[] =
+".section .bfc_counters,\"aw\",@progbits\n"
+"        .balign     8\n"
+"profile:\n"
+"        .ascii      \"%s\"\n"
+"        .quad       %zu\n"
+"profile_counters:\n";
+static const char profile_loop[] =
+"        .quad       %i,0,0\n";
+static const char profile_end[] =
+"profile_end:\n"
+"profile_filename:\n";
+static const char count_profile_event[] =
+"        addq        $1,profile_counters+%zu(%%rip)\n";
+static const char dump_profile[] =
+"        movl        $2,%%eax\n"
+"        leaq        profile_filename(%%rip),%%rdi\n"
+"        movl        $0x241,%%esi\n"
+"        movl        $0644,%%edx\n"
+"        syscall\n"
+"        testq       %%rax,%%rax\n"
+"        js          .Lprofile_done\n"
+"        movq        %%rax,%%rdi\n"
+"        leaq        profile(%%rip),%%rsi\n"
+"        movl        $profile_end-profile,%%edx\n"
+"        movl        $1,%%eax\n"
+"        syscall\n"
+"        movl        $3,%%eax\n"
+"        syscall\n"
+".Lprofile_done:\n";
+
 static const char call_getchar[] =
 "        call        getchar\n";
 static const char call_putchar[] =
 "        call        putchar\n";
 
+/* The same program as machine code.  The data area holds the array,
+   the input and output buffers and their state.  */
+#define HAVE_ENCODER 1
+
+enum
+{
+  ARRAY_OFFSET          = 0,
+  OUTPUT_LENGTH_OFFSET  = (ARRAY_OFFSET + DATA_ARRAY_SIZE + 7) / 8 * 8,
+  INPUT_POSITION_OFFSET = OUTPUT_LENGTH_OFFSET + 8,
+  INPUT_LENGTH_OFFSET   = INPUT_POSITION_OFFSET + 8,
+  INTERACTIVE_OFFSET    = INPUT_LENGTH_OFFSET + 8,
+  TERMIOS_OFFSET        = INTERACTIVE_OFFSET + 8,
+  INPUT_OFFSET          = TERMIOS_OFFSET + 64,
+  OUTPUT_OFFSET         = INPUT_OFFSET + INPUT_BUFFER_SIZE
+};
+#define DATA_AREA_SIZE (OUTPUT_OFFSET + output_buffer_size)
+
+static void
+encode_flush_body (CodeBuffer *code)
+{
+  const Label write = new_label (code);
+  const Label done = new_label (code);
+
+  x86_push (code, RAX);
+  x86_lea (code, RSI, DATA (OUTPUT_OFFSET));
+  x86_load64 (code, RDX, DATA (OUTPUT_LENGTH_OFFSET));
+  bind_label (code, write);
+  x86_test (code, RDX, RDX);
+  x86_jump (code, CC_E, done);
+  x86_mov_imm32 (code, RAX, 1);
+  x86_mov_imm32 (code, RDI, 1);
+  x86_syscall (code);
+  x86_test (code, RAX, RAX);
+  x86_jump (code, CC_LE, done);
+  x86_alu_reg (code, ALU_ADD, RSI, RAX);
+  x86_alu_reg (code, ALU_SUB, RDX, RAX);
+  x86_jump (code, JUMP_ALWAYS, write);
+  bind_label (code, done);
+  x86_store64_imm (code, DATA (OUTPUT_LENGTH_OFFSET), 0);
+  x86_pop (code, RAX);
+  x86_ret (code);
+}
+
+static void
+encode_getchar_body (CodeBuffer *code, Label flush)
+{
+  const Label read = new_label (code);
+  const Label eof = new_label (code);
+
+  x86_call (code, flush);
+  x86_load64 (code, RCX, DATA (INPUT_POSITION_OFFSET));
+  x86_load64 (code, RDX, DATA (INPUT_LENGTH_OFFSET));
+  x86_alu_reg (code, ALU_CMP, RCX, RDX);
+  x86_jump (code, CC_B, read);
+  x86_push (code, RAX);
+  x86_alu_reg (code, ALU_XOR, RAX, RAX);
+  x86_alu_reg (code, ALU_XOR, RDI, RDI);
+  x86_lea (code, RSI, DATA (INPUT_OFFSET));
+  x86_mov_imm32 (code, RDX, INPUT_BUFFER_SIZE);
+  x86_syscall (code);
+  x86_mov_reg (code, RDX, RAX);
+  x86_pop (code, RAX);
+  x86_test (code, RDX, RDX);
+  x86_jump (code, CC_LE, eof);
+  x86_store64 (code, DATA (INPUT_LENGTH_OFFSET), RDX);
+  x86_alu_reg (code, ALU_XOR, RCX, RCX);
+  bind_label (code, read);
+  x86_lea (code, RDX, DATA (INPUT_OFFSET));
+  x86_alu_reg (code, ALU_ADD, RDX, RCX);
+  x86_load8 (code, RBX, MEMORY (RDX, 0));
+  x86_store8 (code, MEMORY (RAX, 0), RBX);
+  x86_alu_imm (code, ALU_ADD, RCX, 1);
+  x86_store64 (code, DATA (INPUT_POSITION_OFFSET), RCX);
+  x86_ret (code);
+  bind_label (code, eof);
+  if (eof_policy == EOF_ZERO)
+    x86_store8_imm (code, MEMORY (RAX, 0), 0);
+  else if (eof_policy == EOF_MINUS_ONE)
+    x86_store8_imm (code, MEMORY (RAX, 0), 255);
+  x86_ret (code);
+}
+
+static void
+encode_putchar_body (CodeBuffer *code, Label flush)
+{
+  const Label done = new_label (code);
+
+  x86_load64 (code, RCX, DATA (OUTPUT_LENGTH_OFFSET));
+  x86_load8 (code, RBX, MEMORY (RAX, 0));
+  x86_lea (code, RDX, DATA (OUTPUT_OFFSET));
+  x86_alu_reg (code, ALU_ADD, RDX, RCX);
+  x86_store8 (code, MEMORY (RDX, 0), RBX);
+  x86_alu_imm (code, ALU_ADD, RCX, 1);
+  x86_store64 (code, DATA (OUTPUT_LENGTH_OFFSET), RCX);
+  x86_alu_imm (code, ALU_CMP, RCX, output_buffer_size);
+  x86_jump (code, CC_E, flush);
+  x86_alu_mem8_imm (code, ALU_CMP, MEMORY (RDX, 0), '\n');
+  x86_jump (code, CC_NE, done);
+  x86_alu_mem8_imm (code, ALU_CMP, DATA (INTERACTIVE_OFFSET), 0);
+  x86_jump (code, CC_NE, flush);
+  bind_label (code, done);
+  x86_ret (code);
+}
+
+static void
+encode_detect_terminal (CodeBuffer *code)
+{
+  const Label done = new_label (code);
+
+  x86_mov_imm32 (code, RAX, 16);
+  x86_mov_imm32 (code, RDI, 1);
+  x86_mov_imm32 (code, RSI, 0x5401);
+  x86_lea (code, RDX, DATA (TERMIOS_OFFSET));
+  x86_syscall (code);
+  x86_test (code, RAX, RAX);
+  x86_jump (code, CC_NE, done);
+  x86_store8_imm (code, DATA (INTERACTIVE_OFFSET), 1);
+  bind_label (code, done);
+}
+
+/* Code which is called as a function keeps %rbx, clobbered by
+   putchar, and returns instead of exiting.  */
+static void
+encode_start_init (CodeBuffer *code, bool callable)
+{
+  if (callable)
+    x86_push (code, RBX);
+}
+
+static void
+encode_write_constant_output (CodeBuffer *code, Label output, size_t length)
+{
+  const Label write = new_label (code);
+  const Label done = new_label (code);
+
+  x86_lea_label (code, RSI, output);
+  x86_mov_imm32 (code, RDX, length);
+  bind_label (code, write);
+  x86_mov_imm32 (code, RAX, 1);
+  x86_mov_imm32 (code, RDI, 1);
+  x86_syscall (code);
+  x86_test (code, RAX, RAX);
+  x86_jump (code, CC_LE, done);
+  x86_alu_reg (code, ALU_ADD, RSI, RAX);
+  x86_alu_reg (code, ALU_SUB, RDX, RAX);
+  x86_jump (code, CC_NE, write);
+  bind_label (code, done);
+}
+
+static void
+encode_init_pointer (CodeBuffer *code, size_t pointer)
+{
+  x86_lea (code, RAX, DATA (ARRAY_OFFSET + pointer));
+}
+
+static void
+encode_start_fini (CodeBuffer *code, bool callable)
+{
+  if (callable)
+    {
+      x86_pop (code, RBX);
+      x86_ret (code);
+    }
+  else
+    {
+      x86_mov_imm32 (code, RAX, 60);
+      x86_alu_reg (code, ALU_XOR, RDI, RDI);
+      x86_syscall (code);
+    }
+}
+
+static void
+encode_increment_current_value (CodeBuffer *code, i32 value, i32 offset)
+{
+  x86_alu_mem8_imm (code, ALU_ADD, MEMORY (RAX, offset), value);
+}
+
+static void
+encode_decrement_current_value (CodeBuffer *code, i32 value, i32 offset)
+{
+  x86_alu_mem8_imm (code, ALU_SUB, MEMORY (RAX, offset), value);
+}
+
+static void
+encode_set_current_value (CodeBuffer *code, u8 value, i32 offset)
+{
+  x86_store8_imm (code, MEMORY (RAX, offset), value);
+}
+
+static void
+encode_multiply_add (CodeBuffer *code, i32 factor, i32 offset,
+                     i32 source_offset)
+{
+  x86_load8_zero_extend (code, RCX, MEMORY (RAX, source_offset));
+  if (factor == -1)
+    x86_alu_mem8_reg (code, ALU_SUB, MEMORY (RAX, offset), RCX);
+  else
+    {
+      if (factor != 1)
+        x86_imul_imm (code, RCX, RCX, factor);
+      x86_alu_mem8_reg (code, ALU_ADD, MEMORY (RAX, offset), RCX);
+    }
+}
+
+static void
+encode_increment_current_pointer (CodeBuffer *code, i32 value)
+{
+  x86_alu_imm (code, ALU_ADD, RAX, value);
+}
+
+static void
+encode_decrement_current_pointer (CodeBuffer *code, i32 value)
+{
+  x86_alu_imm (code, ALU_SUB, RAX, value);
+}
+
+/* The vector loop is bounded by the array in the data area, so code
+   which runs on other cells asks for the scalar loop only.  */
+static void
+encode_scan (CodeBuffer *code, i32 stride, bool vector)
+{
+  const u32 mask = vector ? scan_mask (stride) : 0;
+  const Label scalar = new_label (code);
+  const Label done = new_label (code);
+
+  if (mask != 0)
+    {
+      const Label vector_loop = new_label (code);
+      const Label found = new_label (code);
+
+      x86_pxor (code, XMM0, XMM0);
+      if (stride > 0)
+        x86_lea (code, RDX, DATA (ARRAY_OFFSET + DATA_ARRAY_SIZE - 16));
+      else
+        x86_lea (code, RDX, DATA (ARRAY_OFFSET + 15));
+      bind_label (code, vector_loop);
+      x86_alu_reg (code, ALU_CMP, RAX, RDX);
+      x86_jump (code, stride > 0 ? CC_A : CC_B, scalar);
+      x86_movdqu_load (code, XMM1, MEMORY (RAX, stride > 0 ? 0 : -15));
+      x86_pcmpeqb (code, XMM1, XMM0);
+      x86_pmovmskb (code, RCX, XMM1);
+      x86_alu_imm (code, ALU_AND, RCX, mask);
+      x86_jump (code, CC_NE, found);
+      x86_alu_imm (code, ALU_ADD, RAX, stride > 0 ? 16 : -16);
+      x86_jump (code, JUMP_ALWAYS, vector_loop);
+      bind_label (code, found);
+      if (stride > 0)
+        x86_bsf (code, RCX, RCX);
+      else
+        {
+          x86_bsr (code, RCX, RCX);
+          x86_alu_imm (code, ALU_SUB, RAX, 15);
+        }
+      x86_alu_reg (code, ALU_ADD, RAX, RCX);
+      x86_jump (code, JUMP_ALWAYS, done);
+    }
+
+  bind_label (code, scalar);
+  x86_alu_mem8_imm (code, ALU_CMP, MEMORY (RAX, 0), 0);
+  x86_jump (code, CC_E, done);
+  x86_alu_imm (code, ALU_ADD, RAX, stride);
+  x86_jump (code, JUMP_ALWAYS, scalar);
+  bind_label (code, done);
+}
+
+static void
+encode_label_begin (CodeBuffer *code, Label begin, Label end)
+{
+  bind_label (code, begin);
+  x86_alu_mem8_imm (code, ALU_CMP, MEMORY (RAX, 0), 0);
+  x86_jump (code, CC_E, end);
+}
+
+static void
+encode_label_end (CodeBuffer *code, Label begin, Label end)
+{
+  bind_label (code, end);
+  x86_alu_mem8_imm (code, ALU_CMP, MEMORY (RAX, 0), 0);
+  x86_jump (code, CC_NE, begin);
+}
+
 int
-compile_to_obj (char *asm_filename, char *obj_filename)
+compile_to_obj (char *asm_filename, char *obj_filename,
+                const ProgramSource *source)
 {
-  char *as[] = { "as", "-O2", "--64", "-o", obj_filename, asm_filename, (char *) NULL };
+  char *as[] = { "as", "-O2", "--64", "-o", obj_filename,
+                 asm_filename != NULL ? asm_filename : "--", (char *) NULL };
 
-  int err = exec (as);
+  int err = exec (as, asm_filename != NULL ? NULL : source);
   if (err != 0)
     error (0, 0, _("error: as returned %i exit status"), err);
 
@@ -120,7 +647,7 @@ link_to_elf (char *obj_filename, char *elf_filename, bool with_debug_info)
       ld[countof (ld) - 1] = "--strip-all";
     }
 
-  int err = exec (ld);
+  int err = exec (ld, NULL);
   if (err != 0)
     error (0, 0, _("error: ld returned %i exit status"), err);
 
@@ -0,0 +1,24 @@
+# Tests of bfc.                                  -*-Makefile-*-
+# This is included by the top-level Makefile.am.
+
+## Copyright (C) 2019 Sergey Sushilin
+
+## This program is free software: you can redistribute it and/or modify
+## it under the terms of the GNU General Public License as published by
+## the Free Software Foundation, either version 3 of the License, or
+## (at your option) any later version.
+##
+## This program is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+TESTS =                                 \
+  tests/tiered-out-of-array.sh
+
+EXTRA_DIST += $(TESTS)
+
+AM_TESTS_ENVIRONMENT = BFC='$(abs_top_builddir)/src/bfc$(EXEEXT)'; export BFC;
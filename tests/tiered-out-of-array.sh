@@ -0,0 +1,46 @@
+#!/bin/sh
+# A hot loop which moves the pointer out of the array is reported by
+# --tiered like by --interpret, and does not crash the compiler.
+
+# Copyright (C) 2019 Sergey Sushilin
+
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+: "${BFC=bfc}"
+
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+
+# The second loop is slowed down by an inner loop, so that it is
+# compiled long before it leaves the array.
+printf '+[>>>>>>>>>>>>>+<<<<<<<<<<<<+]' > "$tmp/a.bf" || exit 1
+printf '+[>>>>>>>>>>>>>+>>--[--]<<<<<<<<<<<<<<+]' > "$tmp/b.bf" || exit 1
+
+fail=0
+for program in a b; do
+  for level in 0 1 2; do
+    for mode in --interpret --tiered; do
+      "$BFC" $mode -O$level "$tmp/$program.bf" 2> "$tmp/err"
+      status=$?
+      if test $status -ne 1 \
+         || ! grep 'pointer moved out of the array' "$tmp/err" > /dev/null; then
+        echo "$program.bf $mode -O$level: exit status $status" >&2
+        cat "$tmp/err" >&2
+        fail=1
+      fi
+    done
+  done
+done
+
+exit $fail